@@ -25,7 +25,55 @@
 
 int allocate(void)
 {
-  atom = (struct atom_struct*) calloc(sim.N, sizeof(struct atom_struct));
-  if (atom == NULL) { fprintf(stdout, "ERROR: cannot allocate memory for atom\n"); return(11); }
+  unsigned long n;
+  double *base;
+  int narrays = 13;
+
+  /* ------------------------------------------------------------------- */
+  /*  Pad each array to a multiple of ALIGN bytes and allocate one       */
+  /*  block large enough to align the first array                        */
+  /* ------------------------------------------------------------------- */
+  n = sim.N + (ALIGN / sizeof(double)) - 1;
+  n -= n % (ALIGN / sizeof(double));
+  atom.stride = n;
+  atom.block = calloc(narrays*n + ALIGN / sizeof(double), sizeof(double));
+  if (atom.block == NULL) { fprintf(stdout, "ERROR: cannot allocate memory for atom\n"); return(11); }
+  base = (double*)(((uintptr_t)atom.block + ALIGN - 1) & ~(uintptr_t)(ALIGN - 1));
+
+  /* ------------------------------------------------------------------- */
+  /*  Assign the arrays                                                  */
+  /* ------------------------------------------------------------------- */
+  atom.x  = base;
+  atom.y  = base + n;
+  atom.z  = base + 2*n;
+  atom.vx = base + 3*n;
+  atom.vy = base + 4*n;
+  atom.vz = base + 5*n;
+  atom.fx = base + 6*n;
+  atom.fy = base + 7*n;
+  atom.fz = base + 8*n;
+  atom.dx = base + 9*n;
+  atom.dy = base + 10*n;
+  atom.dz = base + 11*n;
+  atom.pe = base + 12*n;
+
+  /* ------------------------------------------------------------------- */
+  /*  Allocate the force buffers for the threads.  Thread 0 accumulates  */
+  /*  directly into fx, fy, and fz; thread t > 0 uses the three arrays   */
+  /*  starting at tf + 3*(t-1)*stride.                                   */
+  /* ------------------------------------------------------------------- */
+  atom.nthreads = 1;
+  atom.tf = NULL;
+  atom.tblock = NULL;
+#ifdef _OPENMP
+  atom.nthreads = omp_get_max_threads();
+#endif
+  if (atom.nthreads > 1)
+  {
+    atom.tblock = calloc(3*(atom.nthreads - 1)*n + ALIGN / sizeof(double), sizeof(double));
+    if (atom.tblock == NULL) { fprintf(stdout, "ERROR: cannot allocate memory for the thread force buffers\n"); return(11); }
+    atom.tf = (double*)(((uintptr_t)atom.tblock + ALIGN - 1) & ~(uintptr_t)(ALIGN - 1));
+  }
+
   return(0);
-}
\ No newline at end of file
+}
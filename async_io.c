@@ -0,0 +1,337 @@
+/* Copyright (C) 2017 Thomas Allen Knotts IV - All Rights Reserved          */
+/* This file is part of the program ljmcmd                                  */
+/*                                                                          */
+/* ljmcmd is free software: you can redistribute it and/or modify           */
+/* it under the terms of the GNU General Public License as published by     */
+/* the Free Software Foundation, either version 3 of the License, or        */
+/* (at your option) any later version.                                      */
+/*                                                                          */
+/* ljmcmd is distributed in the hope that it will be useful,                */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of           */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            */
+/* GNU General Public License for more details.                             */
+/*                                                                          */
+/* You should have received a copy of the GNU General Public License        */
+/* along with ljmcmd.  If not, see <http://www.gnu.org/licenses/>.          */
+
+/* ======================================================================== */
+/* async_io.c                                                               */
+/*                                                                          */
+/* This file contains the background I/O thread.  When the keyword asyncio  */
+/* is block or drop, write_trr() and output_log_printf() do not write to    */
+/* disk.  They copy the frame or the formatted line into a preallocated     */
+/* slot of a single-producer/single-consumer ring and return, and the I/O   */
+/* thread encodes and writes the slots in order.  The rings are lock-free:  */
+/* the simulation thread only advances head and the I/O thread only         */
+/* advances tail.                                                           */
+/*                                                                          */
+/* If the frame ring is full, block waits for a free slot and drop skips    */
+/* the frame and counts it.  Property lines always wait so that the output  */
+/* file is complete.  Without POSIX threads the writes stay synchronous.    */
+/* ======================================================================== */
+
+#include "includes.h"
+#if defined(__unix__) || defined(__APPLE__)
+#include <pthread.h>
+#define HAVE_PTHREAD 1
+#endif
+
+/* =======================Constants============================== */
+#define IO_FRAME_SLOTS 4
+#define IO_LINE_SLOTS 256
+#define IO_FRAME_HEADER 16
+#define IO_PAUSE_NS 50000
+/* ============================================================= */
+
+void write_trr_open(void);
+void write_trr_frame(unsigned long, int, double *const*);
+void output_log_puts(const char*);
+void async_io_stop(void);
+extern int FLAG_x, FLAG_v, FLAG_f;
+
+static unsigned long io_dropped = 0;
+
+#ifdef HAVE_PTHREAD
+
+/* ------------------------------------------------------------------- */
+/*  This structure is a ring of nslots slots of size bytes.  head is   */
+/*  the number of slots filled and tail the number of slots emptied.   */
+/* ------------------------------------------------------------------- */
+struct io_ring {
+  unsigned long   nslots;               /* number of slots             */
+  size_t          size;                 /* bytes per slot              */
+  unsigned char   *data;                /* slot storage                */
+  unsigned long   head;                 /* written by the producer     */
+  unsigned long   tail;                 /* written by the consumer     */
+};
+
+static struct io_ring frames, lines;
+static bool io_running = false;
+static int io_stop = 0;
+static pthread_t io_thread;
+
+/* ------------------------------------------------------------------- */
+/*  This function allocates the slots of a ring                        */
+/* ------------------------------------------------------------------- */
+static int ring_allocate(struct io_ring *r, unsigned long nslots, size_t size)
+{
+  r->nslots = nslots;
+  r->size = size;
+  r->head = 0;
+  r->tail = 0;
+  r->data = (unsigned char*) malloc(nslots*size);
+  if (r->data == NULL)
+  {
+    fprintf(stdout, "ERROR: cannot allocate memory for the I/O ring\n");
+    return(11);
+  }
+  return(0);
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function returns the next free slot of a ring for the         */
+/*  producer, or NULL if the ring is full                              */
+/* ------------------------------------------------------------------- */
+static unsigned char* ring_back(struct io_ring *r)
+{
+  if (r->head - __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE) == r->nslots) return(NULL);
+  return(r->data + (r->head % r->nslots)*r->size);
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function publishes the slot returned by ring_back()           */
+/* ------------------------------------------------------------------- */
+static void ring_push(struct io_ring *r)
+{
+  __atomic_store_n(&r->head, r->head + 1, __ATOMIC_RELEASE);
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function returns the oldest filled slot of a ring for the     */
+/*  consumer, or NULL if the ring is empty                             */
+/* ------------------------------------------------------------------- */
+static unsigned char* ring_front(struct io_ring *r)
+{
+  if (__atomic_load_n(&r->head, __ATOMIC_ACQUIRE) == r->tail) return(NULL);
+  return(r->data + (r->tail % r->nslots)*r->size);
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function releases the slot returned by ring_front()           */
+/* ------------------------------------------------------------------- */
+static void ring_pop(struct io_ring *r)
+{
+  __atomic_store_n(&r->tail, r->tail + 1, __ATOMIC_RELEASE);
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function returns true if the consumer has emptied the ring    */
+/* ------------------------------------------------------------------- */
+static bool ring_empty(struct io_ring *r)
+{
+  return(__atomic_load_n(&r->tail, __ATOMIC_ACQUIRE) == r->head);
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function sleeps for a short time while a ring is full or      */
+/*  empty                                                              */
+/* ------------------------------------------------------------------- */
+static void io_pause(void)
+{
+  struct timespec ts = {0, IO_PAUSE_NS};
+
+  nanosleep(&ts, NULL);
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function is the I/O thread.  It writes the queued lines and   */
+/*  frames until it is told to stop and both rings are empty.          */
+/* ------------------------------------------------------------------- */
+static void* io_main(void *arg)
+{
+  unsigned char *slot;
+  double *v[9], *p;
+  unsigned long cycle;
+  int flag, k;
+  bool idle;
+
+  (void)arg;
+  for (;;)
+  {
+    idle = true;
+    while ((slot = ring_front(&lines)) != NULL)
+    {
+      output_log_puts((const char*)slot);
+      ring_pop(&lines);
+      idle = false;
+    }
+    if ((slot = ring_front(&frames)) != NULL)
+    {
+      memcpy(&cycle, slot, sizeof(unsigned long));
+      memcpy(&flag, slot + sizeof(unsigned long), sizeof(int));
+      p = (double*)(slot + IO_FRAME_HEADER);
+      for (k = 0; k < 9; k++)
+      {
+        v[k] = NULL;
+        if ((k < 3 && FLAG_x) || (k >= 3 && k < 6 && FLAG_v) || (k >= 6 && FLAG_f))
+        {
+          v[k] = p;
+          p += sim.N;
+        }
+      }
+      write_trr_frame(cycle, flag, v);
+      ring_pop(&frames);
+      idle = false;
+    }
+    if (idle)
+    {
+      if (__atomic_load_n(&io_stop, __ATOMIC_ACQUIRE)) break;
+      io_pause();
+    }
+  }
+  return(NULL);
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function starts the I/O thread if the input file asks for it  */
+/* ------------------------------------------------------------------- */
+int async_io_start(void)
+{
+  int nvec = 3*((FLAG_x != 0) + (FLAG_v != 0) + (FLAG_f != 0));
+  int return_flag;
+
+  if (!strcmp(sim.asyncio, "off")) return(0);
+
+  return_flag = ring_allocate(&lines, IO_LINE_SLOTS, LOG_LINE_SIZE);
+  if (return_flag) return(return_flag);
+  return_flag = ring_allocate(&frames, sim.movie ? IO_FRAME_SLOTS : 1, IO_FRAME_HEADER + (sim.movie ? nvec*sim.N*sizeof(double) : 0));
+  if (return_flag) return(return_flag);
+  if (sim.movie) write_trr_open();
+
+  io_stop = 0;
+  io_dropped = 0;
+  if (pthread_create(&io_thread, NULL, io_main, NULL))
+  {
+    fprintf(stdout, "WARNING: the I/O thread could not be started; output is written synchronously.\n");
+    free(lines.data);
+    free(frames.data);
+    return(0);
+  }
+  io_running = true;
+  atexit(async_io_stop);
+  return(0);
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function queues a copy of the current frame.  It returns      */
+/*  false if the I/O thread is not running and the caller must write   */
+/*  the frame itself.                                                  */
+/* ------------------------------------------------------------------- */
+bool async_io_frame(unsigned long cycle, int flag)
+{
+  unsigned char *slot;
+  double *p;
+
+  if (!io_running) return(false);
+
+  while ((slot = ring_back(&frames)) == NULL)
+  {
+    if (!strcmp(sim.asyncio, "drop"))
+    {
+      if (io_dropped == 0) fprintf(stdout, "WARNING: the I/O thread is behind; trajectory frames are being dropped.\n");
+      io_dropped += 1;
+      return(true);
+    }
+    io_pause();
+  }
+
+  memcpy(slot, &cycle, sizeof(unsigned long));
+  memcpy(slot + sizeof(unsigned long), &flag, sizeof(int));
+  p = (double*)(slot + IO_FRAME_HEADER);
+  if (FLAG_x)
+  {
+    memcpy(p, atom.x, sim.N*sizeof(double)); p += sim.N;
+    memcpy(p, atom.y, sim.N*sizeof(double)); p += sim.N;
+    memcpy(p, atom.z, sim.N*sizeof(double)); p += sim.N;
+  }
+  if (FLAG_v)
+  {
+    memcpy(p, atom.vx, sim.N*sizeof(double)); p += sim.N;
+    memcpy(p, atom.vy, sim.N*sizeof(double)); p += sim.N;
+    memcpy(p, atom.vz, sim.N*sizeof(double)); p += sim.N;
+  }
+  if (FLAG_f)
+  {
+    memcpy(p, atom.fx, sim.N*sizeof(double)); p += sim.N;
+    memcpy(p, atom.fy, sim.N*sizeof(double)); p += sim.N;
+    memcpy(p, atom.fz, sim.N*sizeof(double));
+  }
+  ring_push(&frames);
+  return(true);
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function queues a line of the output file.  It returns false  */
+/*  if the I/O thread is not running.                                  */
+/* ------------------------------------------------------------------- */
+bool async_io_line(const char *line)
+{
+  unsigned char *slot;
+
+  if (!io_running) return(false);
+
+  while ((slot = ring_back(&lines)) == NULL) io_pause();
+  strcpy((char*)slot, line);
+  ring_push(&lines);
+  return(true);
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function waits until the I/O thread has written every queued  */
+/*  line and frame                                                     */
+/* ------------------------------------------------------------------- */
+void async_io_drain(void)
+{
+  if (!io_running) return;
+  while (!ring_empty(&lines) || !ring_empty(&frames)) io_pause();
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function writes everything still queued, stops the I/O        */
+/*  thread, and frees the rings                                        */
+/* ------------------------------------------------------------------- */
+void async_io_stop(void)
+{
+  if (!io_running) return;
+  async_io_drain();
+  __atomic_store_n(&io_stop, 1, __ATOMIC_RELEASE);
+  pthread_join(io_thread, NULL);
+  free(lines.data);
+  free(frames.data);
+  io_running = false;
+}
+
+#else
+
+/* ------------------------------------------------------------------- */
+/*  Without POSIX threads every write is done by the caller            */
+/* ------------------------------------------------------------------- */
+int async_io_start(void)
+{
+  if (strcmp(sim.asyncio, "off")) fprintf(stdout, "WARNING: this build has no I/O thread; output is written synchronously.\n");
+  return(0);
+}
+bool async_io_frame(unsigned long cycle, int flag) { return(false); }
+bool async_io_line(const char *line) { return(false); }
+void async_io_drain(void) { }
+void async_io_stop(void) { }
+
+#endif
+
+/* ------------------------------------------------------------------- */
+/*  This function returns the number of trajectory frames dropped      */
+/* ------------------------------------------------------------------- */
+unsigned long async_io_dropped(void)
+{
+  return(io_dropped);
+}
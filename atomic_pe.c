@@ -19,70 +19,143 @@
 /*                                                                          */
 /* This function calculates the potential energy of each atom               */
 /* with each of its neighbors.  It is used in MC to hold the                */
-/* "old" energies for use in the metropolis criterion.                      */
+/* "old" energies for use in the metropolis criterion.  The atom's          */
+/* contribution to the virial is added to *virial.                          */
 /* ======================================================================== */
 
 #include "includes.h"
 
-double atomic_pe(unsigned long particle, double x, double y, double z)
+double lj_energy_range(double, double, double, unsigned long, unsigned long, double*);
+double lj_delta_range(const double*, const double*, unsigned long, unsigned long, double*);
+double lj_energy_list(double, double, double, const unsigned long*, unsigned long, double*);
+double lj_delta_list(const double*, const double*, const unsigned long*, unsigned long, double*, double*, double*);
+unsigned long cell_list_index(struct cell_struct*, double, double, double);
+unsigned long mc_cell_list_gather(unsigned long*, unsigned long, unsigned long, unsigned long, unsigned long*);
+
+/* ------------------------------------------------------------------- */
+/*  A Lennard Jones pair energy is never below -epsilon.  The bound    */
+/*  is widened slightly to allow for round-off.                        */
+/* ------------------------------------------------------------------- */
+static const double pair_min = -1.0 - 1.0e-12;
+
+/* ------------------------------------------------------------------- */
+/*  The number of atoms and the new energy of the last trial move.     */
+/*  The atoms and the changes in their pair energies are left in       */
+/*  mccells.jlist and mccells.du.                                      */
+/* ------------------------------------------------------------------- */
+static unsigned long ntrial;
+static double utrial;
+
+double atomic_pe(unsigned long particle, double x, double y, double z, double *virial)
 {
-	unsigned long i;
-	double drx, dry, drz;
-	double u;
-	double dr2, dr4, dr6, dr12, dr;
+  double u;
 
   /* ------------------------------------------------------------------- */
-  /*  Calculate the energy of the new configuration                      */
+  /*  Calculate the energy of the configuration with every atom except   */
+  /*  the particle itself                                                */
   /* ------------------------------------------------------------------- */
-	u = 0.0;
-	for (i = 0; i < sim.N; i++)
-	{
-		if (particle != i)
-		{
-			drx = atom[i].x - x;
-			dry = atom[i].y - y;
-			drz = atom[i].z - z;
-
-			/* ============================================ */
-			/*         Minimum Image Convention             */
-			/* ============================================ */
-			if (fabs(drx) > (sim.length*0.5))
-			{
-				if (drx < 0.0)
-					drx += sim.length;
-				else
-					drx -= sim.length;
-			}
-			if (fabs(dry)>(sim.length*0.5))
-			{
-				if (dry < 0.0)
-					dry += sim.length;
-				else
-					dry -= sim.length;
-			}
-			if (fabs(drz)>(sim.length*0.5))
-			{
-				if (drz < 0.0)
-					drz += sim.length;
-				else
-					drz -= sim.length;
-			}
-
-			/* ============================================ */
-			/*         Distance and Energy Calculation      */
-			/* ============================================ */
-			dr = drx*drx + dry*dry + drz*drz;
-			if (dr < sim.rc2)
-			{
-				dr2 = 1 / dr;
-				dr4 = dr2*dr2;
-				dr6 = dr4*dr2;
-				dr12 = dr6*dr6;
-
-				u += 4.0*(dr12 - dr6);
-			}//if  rcut
-		}//if particle != i
-	}//for i
-
-	return(u);
-}
\ No newline at end of file
+  u = lj_energy_range(x, y, z, 0, particle, virial);
+  u += lj_energy_range(x, y, z, particle + 1, sim.N, virial);
+
+  return(u);
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function returns the change in energy when the particle is    */
+/*  moved from its current position to (x, y, z).  The old and new     */
+/*  energies are found in one pass over the other atoms.  The change   */
+/*  in the virial is added to *dvirial.                                */
+/* ------------------------------------------------------------------- */
+double atomic_pe_delta(unsigned long particle, double x, double y, double z, double *dvirial)
+{
+  double ro[3], rn[3];
+  double de;
+
+  ro[0] = atom.x[particle];
+  ro[1] = atom.y[particle];
+  ro[2] = atom.z[particle];
+  rn[0] = x;
+  rn[1] = y;
+  rn[2] = z;
+
+  de = lj_delta_range(ro, rn, 0, particle, dvirial);
+  de += lj_delta_range(ro, rn, particle + 1, sim.N, dvirial);
+
+  return(de);
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function sets atom.pe[i] to the energy of each atom with all  */
+/*  of its neighbors in the MC cell list.                              */
+/* ------------------------------------------------------------------- */
+void atomic_pe_all(void)
+{
+  double vir = 0.0;
+  unsigned long i, n;
+
+  for (i = 0; i < sim.N; i++)
+  {
+    n = mc_cell_list_gather(mccells.jlist, i, mccells.cell[i], mccells.cell[i], NULL);
+    atom.pe[i] = lj_energy_list(atom.x[i], atom.y[i], atom.z[i], mccells.jlist, n, &vir);
+  }
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function tests a move of the particle to (x, y, z) that is    */
+/*  accepted if the change in energy is below demax.  The old and new  */
+/*  pair energies are summed one shell of cells at a time, nearest to  */
+/*  the new position first.  Since the old energy is known from        */
+/*  atom.pe, the move is rejected as soon as the partial new energy is */
+/*  too high to be brought below the threshold by the remaining pairs. */
+/*  Returns true if the move is accepted and sets *de and *dvirial.    */
+/* ------------------------------------------------------------------- */
+bool atomic_pe_trial(unsigned long particle, double x, double y, double z, double demax,
+                     double *de, double *dvirial)
+{
+  double ro[3], rn[3];
+  double uold = 0.0;
+  double umax = atom.pe[particle] + demax;
+  unsigned long end[4], start;
+  int s;
+
+  ro[0] = atom.x[particle];
+  ro[1] = atom.y[particle];
+  ro[2] = atom.z[particle];
+  rn[0] = x;
+  rn[1] = y;
+  rn[2] = z;
+
+  ntrial = mc_cell_list_gather(mccells.jlist, particle, cell_list_index(&mccells.grid, x, y, z), mccells.cell[particle], end);
+  mccells.npairs += ntrial;
+  utrial = 0.0;
+
+  for (s = 0, start = 0; s < 3; start = end[s], s++)
+  {
+    utrial += lj_delta_list(ro, rn, mccells.jlist + start, end[s] - start, mccells.du + start, &uold, dvirial);
+    if (utrial + pair_min*(double)(end[3] - end[s]) > umax)
+    {
+      mccells.nskipped += ntrial - end[s];
+      return(false);
+    }
+  }
+
+  /* ============================================ */
+  /*  The last shell and the cells that are only  */
+  /*  around the old position                     */
+  /* ============================================ */
+  utrial += lj_delta_list(ro, rn, mccells.jlist + start, ntrial - start, mccells.du + start, &uold, dvirial);
+  *de = utrial - uold;
+  return(*de < demax);
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function updates atom.pe after the last trial move has been   */
+/*  accepted.                                                          */
+/* ------------------------------------------------------------------- */
+void atomic_pe_accept(unsigned long particle)
+{
+  unsigned long k;
+
+  for (k = 0; k < ntrial; k++) atom.pe[mccells.jlist[k]] += mccells.du[k];
+  atom.pe[particle] = utrial;
+}
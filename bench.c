@@ -0,0 +1,449 @@
+/* Copyright (C) 2017 Thomas Allen Knotts IV - All Rights Reserved          */
+/* This file is part of the program ljmcmd                                  */
+/*                                                                          */
+/* ljmcmd is free software: you can redistribute it and/or modify           */
+/* it under the terms of the GNU General Public License as published by     */
+/* the Free Software Foundation, either version 3 of the License, or        */
+/* (at your option) any later version.                                      */
+/*                                                                          */
+/* ljmcmd is distributed in the hope that it will be useful,                */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of           */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            */
+/* GNU General Public License for more details.                             */
+/*                                                                          */
+/* You should have received a copy of the GNU General Public License        */
+/* along with ljmcmd.  If not, see <http://www.gnu.org/licenses/>.          */
+
+
+/* ======================================================================== */
+/* bench.c                                                                  */
+/*                                                                          */
+/* This is the main subroutine for ljmdmc_bench, which times the hot        */
+/* kernels of ljmdmc in isolation: forces(), forces_verlet(), verlet1()     */
+/* and verlet2(), rdf_accumulate(), move(), the energy of a trial move,     */
+/* and write_trr().                                                         */
+/* It is built from the same sources as ljmdmc (type "make bench") and      */
+/* sweeps the number of particles and the density on FCC lattices made by   */
+/* initialize_positions().  Each kernel is called in batches that double    */
+/* in size until a batch takes the minimum time, and the time per call of   */
+/* the last batch is reported.  The results are written as JSON, to stdout  */
+/* or to the file given with -o, so that builds can be compared.  With -o a */
+/* summary table is also written to stdout.                                 */
+/*                                                                          */
+/* usage: ljmdmc_bench [-N n1,n2,...] [-rho r1,r2,...] [-t seconds]         */
+/*                     [-o file.json]                                       */
+/* ======================================================================== */
+
+#define MAIN
+#include "includes.h"
+
+int allocate(void);
+int initialize_positions(char*, char*);
+int initialize_velocities(char*, char*);
+int cell_list_allocate(struct cell_struct*, double);
+void cell_list_free(struct cell_struct*);
+int neighbor_list_allocate(void);
+void neighbor_list_free(void);
+int mc_cell_list_allocate(void);
+void mc_cell_list_build(void);
+void mc_cell_list_free(void);
+void atomic_pe_all(void);
+double atomic_pe(unsigned long, double, double, double, double*);
+bool   atomic_pe_trial(unsigned long, double, double, double, double, double*, double*);
+int rdf_allocate(void);
+void rdf_free(void);
+int rdf_accumulate(tak_histogram*);
+void lj_kernel_select(void);
+const char* lj_kernel_name(void);
+double ran_num_double(long, int, int);
+double forces(void);
+double forces_verlet(double*, tak_histogram*);
+int verlet1(void);
+int verlet2(void);
+bool move(void);
+void write_trr(unsigned long, int);
+void write_trr_flush(void);
+void write_trr_close(void);
+double wall_clock(void);
+int error_exit(int);
+
+#define BENCH_MAX_CASES 16      /* most values of N or rho in a sweep */
+
+/* ------------------------------------------------------------------- */
+/*  The results of one configuration                                   */
+/* ------------------------------------------------------------------- */
+struct bench_result {
+  unsigned long   N;                    /* number of particles                  */
+  double          rho;                  /* density [rho*]                       */
+  double          length;               /* length of simulation box             */
+  double          pairs;                /* pairs within the cutoff              */
+  double          forces_ms;            /* time of one forces() call [ms]       */
+  double          ns_per_pair;          /* forces() time per pair [ns]          */
+  double          md_steps_per_s;       /* forces_verlet() steps per second     */
+  double          verlet_ns_per_atom;   /* verlet1() + verlet2() per atom [ns]  */
+  double          rdf_ms;               /* time of one rdf_accumulate() [ms]    */
+  double          mc_trials_per_s;      /* move() trials per second             */
+  double          mc_acceptance;        /* fraction of the trials accepted      */
+  double          atomic_pe_ns_per_pair;/* trial energy time per pair [ns]      */
+  double          trr_mb_per_s;         /* trr frame writing [MB/s]             */
+  double          trr_frames_per_s;     /* trr frames written per second        */
+  double          xtc_mb_per_s;         /* xtc frame writing [MB/s]             */
+  double          xtc_frames_per_s;     /* xtc frames written per second        */
+};
+
+static tak_histogram *bench_rdf;       /* histogram filled by the rdf benchmark */
+static unsigned long bench_particle;   /* next particle for the trial energy    */
+static double bench_pairs;             /* pairs visited by the trial energies   */
+static double bench_calls;             /* trial energies computed               */
+
+/* ------------------------------------------------------------------- */
+/*  These functions wrap the kernels so that they can be timed by      */
+/*  time_per_call()                                                    */
+/* ------------------------------------------------------------------- */
+static void call_forces(void) { forces(); }
+static void call_verlet(void) { verlet1(); verlet2(); }
+static void call_rdf(void) { rdf_accumulate(bench_rdf); }
+static void call_move(void) { move(); }
+
+static void call_md_step(void)
+{
+  double ke;
+  iprop.pe = forces_verlet(&ke, NULL);
+}
+
+/* ------------------------------------------------------------------- */
+/*  The energy of a particle at its own position as computed for a MC  */
+/*  trial move: over the MC cell list, never stopped early, if there   */
+/*  is one and over all other atoms otherwise.  The pairs visited are  */
+/*  counted so that the time can be given per pair.                    */
+/* ------------------------------------------------------------------- */
+static void call_atomic_pe(void)
+{
+  double vir = 0.0, de, p0;
+  unsigned long i = bench_particle;
+
+  if (mccells.grid.n >= 3)
+  {
+    p0 = mccells.npairs - mccells.nskipped;
+    atomic_pe_trial(i, atom.x[i], atom.y[i], atom.z[i], HUGE_VAL, &de, &vir);
+    bench_pairs += mccells.npairs - mccells.nskipped - p0;
+  }
+  else
+  {
+    atomic_pe(i, atom.x[i], atom.y[i], atom.z[i], &vir);
+    bench_pairs += (double)(sim.N - 1);
+  }
+  bench_calls += 1.0;
+  bench_particle = (i + 1) % sim.N;
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function returns the time in seconds of one call of fn.  The  */
+/*  calls are made in batches of 1, 2, 4, ... until a batch takes at   */
+/*  least tmin seconds.  One call is made first to warm the caches.    */
+/* ------------------------------------------------------------------- */
+static double time_per_call(void (*fn)(void), double tmin)
+{
+  unsigned long n = 1, k;
+  double t0, t;
+
+  fn();
+  for (;;)
+  {
+    t0 = wall_clock();
+    for (k = 0; k < n; k++) fn();
+    t = wall_clock() - t0;
+    if (t >= tmin) return(t / (double)n);
+    n *= 2;
+  }
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function returns the rate in MB/s at which frames of the      */
+/*  current configuration are written in the given format and stores   */
+/*  the frames per second in fps.  The file is started over for each   */
+/*  batch so that it holds one batch only, and it is removed at the    */
+/*  end.                                                               */
+/* ------------------------------------------------------------------- */
+static double frame_rate(const char *format, double tmin, double *fps)
+{
+  unsigned long n = 1, k;
+  double t0, t;
+  long bytes = 0;
+  FILE *fp;
+
+  sprintf(sim.moviefile, "ljmdmc_bench.%s", format);
+  strcpy(sim.movieformat, format);
+  for (;;)
+  {
+    write_trr_close();
+    remove(sim.moviefile);
+    t0 = wall_clock();
+    for (k = 0; k < n; k++) write_trr(k, 0);
+    write_trr_flush();
+    t = wall_clock() - t0;
+    if (t >= tmin) break;
+    n *= 2;
+  }
+  write_trr_close();
+
+  fp = fopen(sim.moviefile, "rb");
+  if (fp != NULL)
+  {
+    fseek(fp, 0, SEEK_END);
+    bytes = ftell(fp);
+    fclose(fp);
+  }
+  remove(sim.moviefile);
+
+  *fps = (double)n / t;
+  return((double)bytes / t / 1.0e6);
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function sets up a configuration of N particles at density    */
+/*  rho the same way main() does for an md run with generated          */
+/*  coordinates and velocities, times each kernel, and frees the       */
+/*  arrays.                                                            */
+/* ------------------------------------------------------------------- */
+static int bench_case(unsigned long N, double rho, double tmin, struct bench_result *r)
+{
+  double t, *save;
+  int i, return_flag;
+
+  /* ------------------------------------------------------------------- */
+  /*  Set the simulation parameters                                      */
+  /* ------------------------------------------------------------------- */
+  strcpy(sim.type, "md");
+  sim.N = N;
+  sim.rho = rho;
+  sim.T = 1.0;
+  sim.rc = 2.5;
+  sim.rc2 = sim.rc*sim.rc;
+  sim.skin = 0.3;
+  sim.dt = 0.005;
+  sim.eq = 0;
+  sim.pr = 0;
+  sim.seed = -827165783;
+  sim.rdfmin = 0.0;
+  sim.rdfmax = sim.rc;
+  sim.rdfN = 100;
+  sim.rdf = 1;
+  strcpy(sim.icoord, "generate");
+  strcpy(sim.ivel, "generate");
+  strcpy(sim.inputfile, "ljmdmc_bench");
+  strcpy(sim.sweep, "serial");
+  strcpy(sim.asyncio, "off");
+  memset(&iprop, 0, sizeof(iprop));
+
+  /* ------------------------------------------------------------------- */
+  /*  Allocate the arrays and generate the configuration                 */
+  /* ------------------------------------------------------------------- */
+  return_flag = allocate();
+  if (return_flag) return(return_flag);
+  return_flag = initialize_positions(sim.icoord, sim.inputfile);
+  if (return_flag) return(return_flag);
+  return_flag = cell_list_allocate(&cells, sim.rc + sim.skin);
+  if (return_flag) return(return_flag);
+  return_flag = neighbor_list_allocate();
+  if (return_flag) return(return_flag);
+  return_flag = rdf_allocate();
+  if (return_flag) return(return_flag);
+  ran_num_double(sim.seed, 0, 1);
+  return_flag = initialize_velocities(sim.ivel, sim.inputfile);
+  if (return_flag) return(return_flag);
+  iprop.pe = forces();
+
+  r->N = sim.N;
+  r->rho = sim.rho;
+  r->length = sim.length;
+
+  /* ------------------------------------------------------------------- */
+  /*  Count the pairs within the cutoff with the rdf and time it         */
+  /* ------------------------------------------------------------------- */
+  bench_rdf = tak_histogram_calloc_uniform(sim.rdfN, sim.rdfmin, sim.rdfmax);
+  rdf_accumulate(bench_rdf);
+  r->pairs = 0.0;
+  for (i = 0; i < bench_rdf->n; i++) r->pairs += bench_rdf->bin[i];
+  r->rdf_ms = 1.0e3 * time_per_call(call_rdf, tmin);
+  tak_histogram_free(bench_rdf);
+
+  /* ------------------------------------------------------------------- */
+  /*  Time the forces, the integration, and whole md steps.  The atoms   */
+  /*  are put back after the integration, since repeating it with the    */
+  /*  same forces does not follow a physical trajectory.                 */
+  /* ------------------------------------------------------------------- */
+  t = time_per_call(call_forces, tmin);
+  r->forces_ms = 1.0e3 * t;
+  r->ns_per_pair = (r->pairs > 0.0) ? 1.0e9 * t / r->pairs : 0.0;
+  save = (double*) malloc(13*atom.stride*sizeof(double));
+  if (save == NULL) { fprintf(stdout, "ERROR: cannot allocate memory for the benchmark\n"); return(11); }
+  memcpy(save, atom.x, 13*atom.stride*sizeof(double));
+  r->verlet_ns_per_atom = 1.0e9 * time_per_call(call_verlet, tmin) / (double)sim.N;
+  memcpy(atom.x, save, 13*atom.stride*sizeof(double));
+  free(save);
+  r->md_steps_per_s = 1.0 / time_per_call(call_md_step, tmin);
+
+  /* ------------------------------------------------------------------- */
+  /*  Time the frames of the configuration reached by the md steps       */
+  /* ------------------------------------------------------------------- */
+  r->trr_mb_per_s = frame_rate("trr", tmin, &r->trr_frames_per_s);
+  r->xtc_mb_per_s = frame_rate("xtc", tmin, &r->xtc_frames_per_s);
+
+  /* ------------------------------------------------------------------- */
+  /*  Time the energy of single particles and MC trial moves.  In mc     */
+  /*  sim.dt is the largest displacement.                                */
+  /* ------------------------------------------------------------------- */
+  strcpy(sim.type, "mc");
+  sim.dt = 0.1;
+  return_flag = mc_cell_list_allocate();
+  if (return_flag) return(return_flag);
+  if (mccells.grid.n >= 3)
+  {
+    mc_cell_list_build();
+    atomic_pe_all();
+  }
+  iprop.pe = forces();
+  bench_particle = 0;
+  bench_pairs = 0.0;
+  bench_calls = 0.0;
+  t = time_per_call(call_atomic_pe, tmin);
+  r->atomic_pe_ns_per_pair = (bench_pairs > 0.0) ? 1.0e9 * t * bench_calls / bench_pairs : 0.0;
+  iprop.ntrys = 0;
+  iprop.naccept = 0;
+  r->mc_trials_per_s = 1.0 / time_per_call(call_move, tmin);
+  r->mc_acceptance = (iprop.ntrys > 0) ? (double)iprop.naccept / (double)iprop.ntrys : 0.0;
+
+  /* ------------------------------------------------------------------- */
+  /*  Free the arrays                                                    */
+  /* ------------------------------------------------------------------- */
+  free(atom.block);
+  free(atom.tblock);
+  cell_list_free(&cells);
+  neighbor_list_free();
+  rdf_free();
+  mc_cell_list_free();
+
+  return(0);
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function reads a comma separated list of numbers into v and   */
+/*  returns how many were read, or 0 if the list is bad.               */
+/* ------------------------------------------------------------------- */
+static int read_list(char *s, double *v)
+{
+  char *token, *end;
+  int n = 0;
+
+  for (token = strtok(s, ","); token != NULL; token = strtok(NULL, ","))
+  {
+    if (n == BENCH_MAX_CASES) return(0);
+    v[n] = strtod(token, &end);
+    if (end == token || *end != '\0' || !(v[n] > 0.0)) return(0);
+    n++;
+  }
+  return(n);
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function writes the results as JSON                           */
+/* ------------------------------------------------------------------- */
+static void write_json(FILE *fp, const struct bench_result *r, int n, double tmin)
+{
+  int threads = 1;
+  int i;
+
+#ifdef _OPENMP
+  threads = omp_get_max_threads();
+#endif
+  fprintf(fp, "{\n");
+  fprintf(fp, "  \"program\": \"ljmdmc_bench\",\n");
+  fprintf(fp, "  \"kernel\": \"%s\",\n", lj_kernel_name());
+  fprintf(fp, "  \"threads\": %d,\n", threads);
+  fprintf(fp, "  \"min_time_s\": %g,\n", tmin);
+  fprintf(fp, "  \"rc\": %g,\n", sim.rc);
+  fprintf(fp, "  \"skin\": %g,\n", sim.skin);
+  fprintf(fp, "  \"results\": [\n");
+  for (i = 0; i < n; i++)
+  {
+    fprintf(fp, "    {\"N\": %lu, \"rho\": %g, \"length\": %.6f, \"pairs\": %.0f,\n", r[i].N, r[i].rho, r[i].length, r[i].pairs);
+    fprintf(fp, "     \"forces_ms\": %.6g, \"forces_ns_per_pair\": %.6g, \"md_steps_per_s\": %.6g, \"verlet_ns_per_atom\": %.6g,\n",
+            r[i].forces_ms, r[i].ns_per_pair, r[i].md_steps_per_s, r[i].verlet_ns_per_atom);
+    fprintf(fp, "     \"rdf_ms\": %.6g, \"mc_trials_per_s\": %.6g, \"mc_acceptance\": %.6g, \"atomic_pe_ns_per_pair\": %.6g,\n",
+            r[i].rdf_ms, r[i].mc_trials_per_s, r[i].mc_acceptance, r[i].atomic_pe_ns_per_pair);
+    fprintf(fp, "     \"trr_mb_per_s\": %.6g, \"trr_frames_per_s\": %.6g, \"xtc_mb_per_s\": %.6g, \"xtc_frames_per_s\": %.6g}%s\n",
+            r[i].trr_mb_per_s, r[i].trr_frames_per_s, r[i].xtc_mb_per_s, r[i].xtc_frames_per_s, (i < n - 1) ? "," : "");
+  }
+  fprintf(fp, "  ]\n");
+  fprintf(fp, "}\n");
+}
+
+int main(int argc, char *argv[])
+{
+  double Nlist[BENCH_MAX_CASES] = {500, 4000, 32000};
+  double rholist[BENCH_MAX_CASES] = {0.5, 0.7, 0.9};
+  int nN = 3, nrho = 3;
+  double tmin = 0.2;
+  char *jsonfile = NULL;
+  struct bench_result r[BENCH_MAX_CASES*BENCH_MAX_CASES];
+  int i, j, n, return_flag;
+  FILE *fp;
+
+  /* ------------------------------------------------------------------- */
+  /*  Read the options                                                   */
+  /* ------------------------------------------------------------------- */
+  for (i = 1; i < argc; i++)
+  {
+    if (!strcmp(argv[i], "-N") && i + 1 < argc) nN = read_list(argv[++i], Nlist);
+    else if (!strcmp(argv[i], "-rho") && i + 1 < argc) nrho = read_list(argv[++i], rholist);
+    else if (!strcmp(argv[i], "-t") && i + 1 < argc) tmin = atof(argv[++i]);
+    else if (!strcmp(argv[i], "-o") && i + 1 < argc) jsonfile = argv[++i];
+    else nN = 0;
+    if (nN == 0 || nrho == 0 || !(tmin > 0.0))
+    {
+      fprintf(stdout, "usage: %s [-N n1,n2,...] [-rho r1,r2,...] [-t seconds] [-o file.json]\n", argv[0]);
+      error_exit(ERROR_ARGUMENTS);
+    }
+  }
+
+  lj_kernel_select();
+
+  /* ------------------------------------------------------------------- */
+  /*  Run the sweep                                                      */
+  /* ------------------------------------------------------------------- */
+  if (jsonfile != NULL) fprintf(stdout, "%8s %6s %12s %12s %12s %12s %12s %12s %12s\n", "N", "rho", "ns/pair", "md steps/s",
+          "verlet ns/at", "rdf ms", "mc trials/s", "pe ns/pair", "trr MB/s");
+  n = 0;
+  for (i = 0; i < nN; i++)
+  {
+    for (j = 0; j < nrho; j++)
+    {
+      return_flag = bench_case((unsigned long)Nlist[i], rholist[j], tmin, &r[n]);
+      if (return_flag) error_exit(return_flag);
+      if (jsonfile != NULL) fprintf(stdout, "%8lu %6.3f %12.3f %12.1f %12.3f %12.3f %12.0f %12.3f %12.1f\n", r[n].N, r[n].rho, r[n].ns_per_pair,
+              r[n].md_steps_per_s, r[n].verlet_ns_per_atom, r[n].rdf_ms, r[n].mc_trials_per_s, r[n].atomic_pe_ns_per_pair, r[n].trr_mb_per_s);
+      fflush(stdout);
+      n++;
+    }
+  }
+
+  /* ------------------------------------------------------------------- */
+  /*  Write the results                                                  */
+  /* ------------------------------------------------------------------- */
+  if (jsonfile == NULL) write_json(stdout, r, n, tmin);
+  else
+  {
+    fp = fopen(jsonfile, "w");
+    if (fp == NULL)
+    {
+      fprintf(stdout, "The benchmark file \"%s\" could not be opened.\n", jsonfile);
+      error_exit(ERROR_FILE_NOT_FOUND);
+    }
+    write_json(fp, r, n, tmin);
+    fclose(fp);
+    fprintf(stdout, "The results were written to \"%s\".\n", jsonfile);
+  }
+
+  return(0);
+}
@@ -0,0 +1,137 @@
+/* Copyright (C) 2017 Thomas Allen Knotts IV - All Rights Reserved          */
+/* This file is part of the program ljmcmd                                  */
+/*                                                                          */
+/* ljmcmd is free software: you can redistribute it and/or modify           */
+/* it under the terms of the GNU General Public License as published by     */
+/* the Free Software Foundation, either version 3 of the License, or        */
+/* (at your option) any later version.                                      */
+/*                                                                          */
+/* ljmcmd is distributed in the hope that it will be useful,                */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of           */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            */
+/* GNU General Public License for more details.                             */
+/*                                                                          */
+/* You should have received a copy of the GNU General Public License        */
+/* along with ljmcmd.  If not, see <http://www.gnu.org/licenses/>.          */
+
+/* ======================================================================== */
+/* cell_list.c                                                              */
+/*                                                                          */
+/* This file contains the subroutines for the linked-cell list.  The box    */
+/* is divided into cells whose sides are at least as long as the cutoff so  */
+/* that an atom only interacts with atoms in its own cell and in the 26     */
+/* surrounding cells.  See page 149 of Allen and Tildesley.                 */
+/* ======================================================================== */
+
+#include "includes.h"
+
+/* ------------------------------------------------------------------- */
+/*  This function sets the number of cells for cutoff rcut and         */
+/*  allocates the arrays.  If there are fewer than 3 cells per side    */
+/*  the cells would see themselves through the periodic boundaries,    */
+/*  so n is left below 3 and the callers use the all-pairs loops.      */
+/* ------------------------------------------------------------------- */
+int cell_list_allocate(struct cell_struct *c, double rcut)
+{
+  c->n = (int)(sim.length / rcut);
+  c->start = NULL;
+  c->index = NULL;
+  c->cell = NULL;
+  if (c->n < 3) return(0);
+
+  c->ncells = c->n*c->n*c->n;
+  c->width = sim.length / (double)c->n;
+  c->start = (unsigned long*) calloc(c->ncells + 1, sizeof(unsigned long));
+  c->index = (unsigned long*) calloc(sim.N, sizeof(unsigned long));
+  c->cell = (unsigned long*) calloc(sim.N, sizeof(unsigned long));
+  if (c->start == NULL || c->index == NULL || c->cell == NULL)
+  {
+    fprintf(stdout, "ERROR: cannot allocate memory for the cell list\n");
+    return(11);
+  }
+  return(0);
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function returns the cell that contains the point (x, y, z).  */
+/*  Points sitting on or just outside the box edges are wrapped back   */
+/*  into the box.                                                      */
+/* ------------------------------------------------------------------- */
+unsigned long cell_list_index(struct cell_struct *c, double x, double y, double z)
+{
+  int ix, iy, iz;
+
+  ix = (int)floor(x / c->width) % c->n;
+  iy = (int)floor(y / c->width) % c->n;
+  iz = (int)floor(z / c->width) % c->n;
+  if (ix < 0) ix += c->n;
+  if (iy < 0) iy += c->n;
+  if (iz < 0) iz += c->n;
+
+  return((unsigned long)((iz*c->n + iy)*c->n + ix));
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function returns the cell at offset (dx, dy, dz) from cell    */
+/*  ic, applying periodic boundary conditions to the cell indices.     */
+/* ------------------------------------------------------------------- */
+unsigned long cell_list_neighbor(struct cell_struct *c, unsigned long ic, int dx, int dy, int dz)
+{
+  int n = c->n;
+  int ix = (int)(ic % n);
+  int iy = (int)((ic / n) % n);
+  int iz = (int)(ic / n / n);
+
+  ix = (ix + dx + n) % n;
+  iy = (iy + dy + n) % n;
+  iz = (iz + dz + n) % n;
+
+  return((unsigned long)((iz*n + iy)*n + ix));
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function sorts the atoms into the cells with a counting sort. */
+/*  It must be called whenever the positions have changed before the   */
+/*  list is used.                                                      */
+/* ------------------------------------------------------------------- */
+void cell_list_build(struct cell_struct *c)
+{
+  unsigned long i, k;
+
+  for (k = 0; k <= (unsigned long)c->ncells; k++) c->start[k] = 0;
+
+  /* ============================================ */
+  /*  Count the atoms in each cell                */
+  /* ============================================ */
+  for (i = 0; i < sim.N; i++)
+  {
+    c->cell[i] = cell_list_index(c, atom.x[i], atom.y[i], atom.z[i]);
+    c->start[c->cell[i] + 1]++;
+  }
+
+  /* ============================================ */
+  /*  Convert the counts to starting positions    */
+  /* ============================================ */
+  for (k = 0; k < (unsigned long)c->ncells; k++) c->start[k + 1] += c->start[k];
+
+  /* ============================================ */
+  /*  Place the atoms, using start[c] as the      */
+  /*  insertion point and then restoring it       */
+  /* ============================================ */
+  for (i = 0; i < sim.N; i++) c->index[c->start[c->cell[i]]++] = i;
+  for (k = c->ncells; k > 0; k--) c->start[k] = c->start[k - 1];
+  c->start[0] = 0;
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function frees the memory of the cell list                    */
+/* ------------------------------------------------------------------- */
+void cell_list_free(struct cell_struct *c)
+{
+  free(c->start);
+  free(c->index);
+  free(c->cell);
+  c->start = NULL;
+  c->index = NULL;
+  c->cell = NULL;
+}
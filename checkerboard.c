@@ -0,0 +1,264 @@
+/* Copyright (C) 2017 Thomas Allen Knotts IV - All Rights Reserved          */
+/* This file is part of the program ljmcmd                                  */
+/*                                                                          */
+/* ljmcmd is free software: you can redistribute it and/or modify           */
+/* it under the terms of the GNU General Public License as published by     */
+/* the Free Software Foundation, either version 3 of the License, or        */
+/* (at your option) any later version.                                      */
+/*                                                                          */
+/* ljmcmd is distributed in the hope that it will be useful,                */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of           */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            */
+/* GNU General Public License for more details.                             */
+/*                                                                          */
+/* You should have received a copy of the GNU General Public License        */
+/* along with ljmcmd.  If not, see <http://www.gnu.org/licenses/>.          */
+
+
+/* ======================================================================== */
+/* checkerboard.c                                                           */
+/*                                                                          */
+/* This file contains the subroutines for checkerboard-parallel MC sweeps.  */
+/* The box is divided into domains that are colored like a 3D checkerboard  */
+/* with 8 colors.  The colors are visited in a random order, and the        */
+/* domains of one color are swept at the same time by different threads.    */
+/* A trial move that would take a particle out of its domain is rejected,   */
+/* so particles in different domains of the same color never interact.  The */
+/* domain grid is shifted by a random offset every sweep so that every      */
+/* point of the box is away from the domain boundaries on average.          */
+/*                                                                          */
+/* Each domain draws its random numbers from its own stream, whose id is    */
+/* made from the sweep and domain numbers, and keeps its own accumulators.  */
+/* The results therefore do not depend on the number of threads.            */
+/* ======================================================================== */
+
+#include "includes.h"
+
+double ran_num_double(long, double, double);
+int    ran_num_int(double, double);
+void   ran_stream_init(struct ran_stream*, long, uint64_t);
+double ran_stream_double(struct ran_stream*, double, double);
+unsigned long cell_list_index(struct cell_struct*, double, double, double);
+unsigned long mc_cell_list_gather(unsigned long*, unsigned long, unsigned long, unsigned long, unsigned long*);
+void   mc_cell_list_update(unsigned long);
+double lj_delta_list(const double*, const double*, const unsigned long*, unsigned long, double*, double*, double*);
+
+/* ------------------------------------------------------------------- */
+/*  This function sets the number of domains and allocates the arrays. */
+/*  A domain must be at least two MC cells wide so that the cells read */
+/*  by a trial move in one domain never hold particles of another      */
+/*  domain of the same color.  With 2 domains per side each color has  */
+/*  one domain and nothing runs in parallel, so if fewer than 4        */
+/*  domains fit per side n is left at 0 and the serial sweep is used.  */
+/* ------------------------------------------------------------------- */
+int checkerboard_allocate(void)
+{
+  int nd;
+
+  domains.n = 0;
+  if (mccells.grid.n < 3) return(0);
+  nd = (int)(sim.length / (2.0*mccells.grid.width));
+  nd -= nd % 2;
+  if (nd < 4) return(0);
+
+  domains.n = nd;
+  domains.ndomains = nd*nd*nd;
+  domains.nsweep = 0;
+  domains.width = sim.length / (double)nd;
+  domains.start = (unsigned long*) calloc(domains.ndomains + 1, sizeof(unsigned long));
+  domains.index = (unsigned long*) calloc(sim.N, sizeof(unsigned long));
+  domains.domain = (unsigned long*) calloc(sim.N, sizeof(unsigned long));
+  domains.rs = (struct ran_stream*) calloc(domains.ndomains, sizeof(struct ran_stream));
+  domains.dpe = (double*) calloc(domains.ndomains, sizeof(double));
+  domains.dvirial = (double*) calloc(domains.ndomains, sizeof(double));
+  domains.naccept = (unsigned long*) calloc(domains.ndomains, sizeof(unsigned long));
+  domains.ntrys = (unsigned long*) calloc(domains.ndomains, sizeof(unsigned long));
+  domains.npairs = (double*) calloc(domains.ndomains, sizeof(double));
+  domains.jlist = (unsigned long*) calloc(atom.nthreads*sim.N, sizeof(unsigned long));
+  domains.du = (double*) calloc(atom.nthreads*sim.N, sizeof(double));
+  if (domains.start == NULL || domains.index == NULL || domains.domain == NULL || domains.rs == NULL ||
+      domains.dpe == NULL || domains.dvirial == NULL || domains.naccept == NULL || domains.ntrys == NULL ||
+      domains.npairs == NULL || domains.jlist == NULL || domains.du == NULL)
+  {
+    fprintf(stdout, "ERROR: cannot allocate memory for the checkerboard domains\n");
+    return(11);
+  }
+  return(0);
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function returns the domain that contains the point (x, y, z) */
+/*  for the current offset of the domain grid.                         */
+/* ------------------------------------------------------------------- */
+static unsigned long domain_index(double x, double y, double z)
+{
+  int n = domains.n;
+  int ix, iy, iz;
+
+  ix = (int)floor((x - domains.offset[0]) / domains.width) % n;
+  iy = (int)floor((y - domains.offset[1]) / domains.width) % n;
+  iz = (int)floor((z - domains.offset[2]) / domains.width) % n;
+  if (ix < 0) ix += n;
+  if (iy < 0) iy += n;
+  if (iz < 0) iz += n;
+
+  return((unsigned long)((iz*n + iy)*n + ix));
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function performs as many trial moves in domain d as it has   */
+/*  particles.  jl and du are the scratch lists of the thread.         */
+/* ------------------------------------------------------------------- */
+static void sweep_domain(unsigned long d, unsigned long *jl, double *du)
+{
+  struct ran_stream *rs = &domains.rs[d];
+  unsigned long *list = &domains.index[domains.start[d]];
+  unsigned long nlist = domains.start[d+1] - domains.start[d];
+  unsigned long t, i, nj;
+  double ro[3], rn[3];
+  double uold, vir, de, demax;
+  int k;
+
+  for (t = 0; t < nlist; t++)
+  {
+    /* ============================================ */
+    /*  Select a particle of the domain and propose */
+    /*  a move that keeps it in the box             */
+    /* ============================================ */
+    i = list[(unsigned long)ran_stream_double(rs, 0.0, (double)nlist)];
+    ro[0] = atom.x[i];
+    ro[1] = atom.y[i];
+    ro[2] = atom.z[i];
+    for (k = 0; k < 3; k++)
+    {
+      rn[k] = ro[k] + ran_stream_double(rs, -1.0, 1.0)*sim.dt;
+      if (rn[k] < 0) rn[k] += sim.length;
+      else if (rn[k] > sim.length) rn[k] -= sim.length;
+    }
+    domains.ntrys[d] += 1;
+    if (domain_index(rn[0], rn[1], rn[2]) != d) continue;
+
+    /* ============================================ */
+    /*  Metropolis test                             */
+    /* ============================================ */
+    demax = -sim.T * log(ran_stream_double(rs, 0.0, 1.0));
+    nj = mc_cell_list_gather(jl, i, cell_list_index(&mccells.grid, rn[0], rn[1], rn[2]), mccells.cell[i], NULL);
+    domains.npairs[d] += (double)nj;
+    uold = 0.0;
+    vir = 0.0;
+    de = lj_delta_list(ro, rn, jl, nj, du, &uold, &vir) - uold;
+    if (de < demax)
+    {
+      domains.naccept[d] += 1;
+      domains.dpe[d] += de;
+      domains.dvirial[d] += vir;
+      atom.x[i] = rn[0];
+      atom.y[i] = rn[1];
+      atom.z[i] = rn[2];
+      mc_cell_list_update(i);
+    }
+  }
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function performs one MC sweep of N trial moves over the      */
+/*  domains and updates the energy, virial, and counters in iprop.     */
+/* ------------------------------------------------------------------- */
+void checkerboard_sweep(void)
+{
+  int n = domains.n, h = domains.n / 2;
+  int order[8], c, k, t;
+  long m;
+  unsigned long i, d;
+
+  /* ------------------------------------------------------------------- */
+  /*  Draw the offset of the domain grid and the order of the colors     */
+  /*  from the main stream, and start the domain streams of this sweep   */
+  /* ------------------------------------------------------------------- */
+  for (k = 0; k < 3; k++) domains.offset[k] = ran_num_double(1, 0.0, domains.width);
+  for (k = 0; k < 8; k++) order[k] = k;
+  for (k = 7; k > 0; k--)
+  {
+    c = ran_num_int(0.0, (double)(k + 1));
+    t = order[k];
+    order[k] = order[c];
+    order[c] = t;
+  }
+  for (d = 0; d < (unsigned long)domains.ndomains; d++)
+  {
+    ran_stream_init(&domains.rs[d], sim.seed, ((uint64_t)(domains.nsweep + 1) << 32) | d);
+    domains.dpe[d] = 0.0;
+    domains.dvirial[d] = 0.0;
+    domains.naccept[d] = 0;
+    domains.ntrys[d] = 0;
+    domains.npairs[d] = 0.0;
+  }
+
+  /* ------------------------------------------------------------------- */
+  /*  Sort the atoms by domain with a counting sort.  Particles cannot   */
+  /*  leave their domain during the sweep, so the lists stay valid.      */
+  /* ------------------------------------------------------------------- */
+  for (d = 0; d <= (unsigned long)domains.ndomains; d++) domains.start[d] = 0;
+  for (i = 0; i < sim.N; i++)
+  {
+    domains.domain[i] = domain_index(atom.x[i], atom.y[i], atom.z[i]);
+    domains.start[domains.domain[i] + 1]++;
+  }
+  for (d = 0; d < (unsigned long)domains.ndomains; d++) domains.start[d + 1] += domains.start[d];
+  for (i = 0; i < sim.N; i++) domains.index[domains.start[domains.domain[i]]++] = i;
+  for (d = domains.ndomains; d > 0; d--) domains.start[d] = domains.start[d - 1];
+  domains.start[0] = 0;
+
+  /* ------------------------------------------------------------------- */
+  /*  Sweep the domains one color at a time.  The h*h*h domains of a     */
+  /*  color have indices 2*(mx, my, mz) + (color bits).                  */
+  /* ------------------------------------------------------------------- */
+  for (c = 0; c < 8; c++)
+  {
+#pragma omp parallel for schedule(dynamic, 1)
+    for (m = 0; m < (long)h*h*h; m++)
+    {
+      int th = 0;
+      int ix = 2*(int)(m % h) + (order[c] & 1);
+      int iy = 2*(int)((m / h) % h) + ((order[c] >> 1) & 1);
+      int iz = 2*(int)(m / h / h) + ((order[c] >> 2) & 1);
+
+#ifdef _OPENMP
+      th = omp_get_thread_num();
+#endif
+      sweep_domain((unsigned long)((iz*n + iy)*n + ix), domains.jlist + th*sim.N, domains.du + th*sim.N);
+    }
+  }
+
+  /* ------------------------------------------------------------------- */
+  /*  Add the changes of the domains in a fixed order                    */
+  /* ------------------------------------------------------------------- */
+  for (d = 0; d < (unsigned long)domains.ndomains; d++)
+  {
+    iprop.pe += domains.dpe[d];
+    iprop.virial += domains.dvirial[d];
+    iprop.naccept += domains.naccept[d];
+    iprop.ntrys += domains.ntrys[d];
+    timers.pairs += domains.npairs[d];
+  }
+  iprop.pe2 = iprop.pe * iprop.pe;
+  domains.nsweep++;
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function frees the memory of the domains                      */
+/* ------------------------------------------------------------------- */
+void checkerboard_free(void)
+{
+  free(domains.start);
+  free(domains.index);
+  free(domains.domain);
+  free(domains.rs);
+  free(domains.dpe);
+  free(domains.dvirial);
+  free(domains.naccept);
+  free(domains.ntrys);
+  free(domains.npairs);
+  free(domains.jlist);
+  free(domains.du);
+}
@@ -0,0 +1,413 @@
+/* Copyright (C) 2017 Thomas Allen Knotts IV - All Rights Reserved          */
+/* This file is part of the program ljmcmd                                  */
+/*                                                                          */
+/* ljmcmd is free software: you can redistribute it and/or modify           */
+/* it under the terms of the GNU General Public License as published by     */
+/* the Free Software Foundation, either version 3 of the License, or        */
+/* (at your option) any later version.                                      */
+/*                                                                          */
+/* ljmcmd is distributed in the hope that it will be useful,                */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of           */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            */
+/* GNU General Public License for more details.                             */
+/*                                                                          */
+/* You should have received a copy of the GNU General Public License        */
+/* along with ljmcmd.  If not, see <http://www.gnu.org/licenses/>.          */
+
+/* ======================================================================== */
+/* checkpoint.c                                                             */
+/*                                                                          */
+/* This file contains the subroutines that write and read the binary        */
+/* checkpoint file.  A checkpoint holds everything needed to continue a run */
+/* exactly as if it had not stopped: the atom arrays, the accumulators, the */
+/* state of the random number stream, the adapted MC step, the neighbor and */
+/* MC cell lists, and the rdf histogram.  The file is written to a          */
+/* temporary name and renamed so that an interrupted write never replaces   */
+/* a good checkpoint.  It is read with one fread and unpacked in memory.    */
+/* The drivers poll checkpoint_stop() once per step so that a SIGTERM, a    */
+/* SIGUSR1, or the end of the walltime budget stops the run at a step       */
+/* boundary with a checkpoint and the averages so far.                      */
+/*                                                                          */
+/* Layout (native byte order, version CKPT_VERSION):                        */
+/*    magic, version, type, N, phase, step, dt, length                      */
+/*    ran, iprop, aprop, the 13 atom arrays                                 */
+/*    rdf: flag [, n, bin[n], Nrdfcalls]                                    */
+/*    neighbor list: flag [, pairs, start, list, dx0, dy0, dz0, counters]   */
+/*    MC cells: flag [, ncells, head, next, prev, cell, counters]           */
+/*    checkerboard sweeps done                                              */
+/* ======================================================================== */
+
+#include "includes.h"
+
+void output_log_flush(void);
+void output_log_printf(const char*, ...);
+void write_trr_flush(void);
+double wall_clock(void);
+
+/* =======================Constants============================== */
+#define CKPT_MAGIC "LJMDMCCK"
+#define CKPT_VERSION 1
+/* ============================================================= */
+
+static double *rdf_bin = NULL;
+static int rdf_n = 0;
+static double rdf_calls = 0.0;
+static volatile sig_atomic_t stop_signal = 0;
+static double stop_start, stop_last;
+static double stop_step = 0.0;
+
+/* ------------------------------------------------------------------- */
+/*  This structure is a cursor into the checkpoint image.  When data   */
+/*  is NULL only the size is counted.                                  */
+/* ------------------------------------------------------------------- */
+struct ckpt_image {
+  unsigned char   *data;                /* image of the file           */
+  size_t          pos;                  /* current offset              */
+  size_t          size;                 /* size of the image           */
+};
+
+/* ------------------------------------------------------------------- */
+/*  This function appends n bytes to the image                         */
+/* ------------------------------------------------------------------- */
+static void put(struct ckpt_image *c, const void *p, size_t n)
+{
+  if (c->data != NULL) memcpy(c->data + c->pos, p, n);
+  c->pos += n;
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function copies the next n bytes of the image to p.  It       */
+/*  returns false if the image is too short.                           */
+/* ------------------------------------------------------------------- */
+static bool get(struct ckpt_image *c, void *p, size_t n)
+{
+  if (c->pos + n > c->size) return(false);
+  memcpy(p, c->data + c->pos, n);
+  c->pos += n;
+  return(true);
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function puts (or counts) the whole state into the image      */
+/* ------------------------------------------------------------------- */
+static void pack(struct ckpt_image *c, int phase, unsigned long step, tak_histogram *h, double Nrdfcalls)
+{
+  uint32_t version = CKPT_VERSION;
+  uint64_t n = sim.N, u;
+  int32_t flag;
+  double *arrays[13];
+  int k;
+
+  put(c, CKPT_MAGIC, 8);
+  put(c, &version, sizeof(version));
+  put(c, sim.type, sizeof(sim.type));
+  put(c, &n, sizeof(n));
+  flag = phase;
+  put(c, &flag, sizeof(flag));
+  u = step;
+  put(c, &u, sizeof(u));
+  put(c, &sim.dt, sizeof(double));
+  put(c, &sim.length, sizeof(double));
+
+  put(c, &ran, sizeof(ran));
+  put(c, &iprop, sizeof(iprop));
+  put(c, &aprop, sizeof(aprop));
+  arrays[0] = atom.x;   arrays[1] = atom.y;   arrays[2] = atom.z;
+  arrays[3] = atom.vx;  arrays[4] = atom.vy;  arrays[5] = atom.vz;
+  arrays[6] = atom.fx;  arrays[7] = atom.fy;  arrays[8] = atom.fz;
+  arrays[9] = atom.dx;  arrays[10] = atom.dy; arrays[11] = atom.dz;
+  arrays[12] = atom.pe;
+  for (k = 0; k < 13; k++) put(c, arrays[k], sim.N*sizeof(double));
+
+  flag = (h != NULL);
+  put(c, &flag, sizeof(flag));
+  if (h != NULL)
+  {
+    put(c, &h->n, sizeof(int));
+    put(c, h->bin, h->n*sizeof(double));
+    put(c, &Nrdfcalls, sizeof(double));
+  }
+
+  flag = (nlist.start != NULL);
+  put(c, &flag, sizeof(flag));
+  if (nlist.start != NULL)
+  {
+    u = nlist.start[sim.N];
+    put(c, &u, sizeof(u));
+    put(c, nlist.start, (sim.N + 1)*sizeof(unsigned long));
+    put(c, nlist.list, u*sizeof(unsigned long));
+    put(c, nlist.dx0, sim.N*sizeof(double));
+    put(c, nlist.dy0, sim.N*sizeof(double));
+    put(c, nlist.dz0, sim.N*sizeof(double));
+    put(c, &nlist.rebuild, sizeof(int));
+    put(c, &nlist.nbuild, sizeof(unsigned long));
+    put(c, &nlist.npairs, sizeof(double));
+  }
+
+  flag = (mccells.grid.n >= 3);
+  put(c, &flag, sizeof(flag));
+  if (mccells.grid.n >= 3)
+  {
+    put(c, &mccells.grid.ncells, sizeof(int));
+    put(c, mccells.head, mccells.grid.ncells*sizeof(long));
+    put(c, mccells.next, sim.N*sizeof(long));
+    put(c, mccells.prev, sim.N*sizeof(long));
+    put(c, mccells.cell, sim.N*sizeof(unsigned long));
+    put(c, &mccells.npairs, sizeof(double));
+    put(c, &mccells.nskipped, sizeof(double));
+  }
+
+  put(c, &domains.nsweep, sizeof(unsigned long));
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function writes a checkpoint after step step of phase phase   */
+/*  (0 equilibration, 1 production).  h is the rdf histogram during    */
+/*  production, or NULL.  The output and movie files are flushed first */
+/*  so that they hold every step up to the checkpoint.                 */
+/* ------------------------------------------------------------------- */
+int checkpoint_write(int phase, unsigned long step, tak_histogram *h, double Nrdfcalls)
+{
+  struct ckpt_image c = {NULL, 0, 0};
+  char tmpfile[140];
+  FILE *fp;
+  size_t written;
+
+  if (ckpt.file[0] == '\0') return(0);
+  output_log_flush(); //also waits for the I/O thread
+  write_trr_flush();
+
+  pack(&c, phase, step, h, Nrdfcalls);
+  c.size = c.pos;
+  c.pos = 0;
+  c.data = (unsigned char*) malloc(c.size);
+  if (c.data == NULL)
+  {
+    fprintf(stdout, "ERROR: cannot allocate memory for the checkpoint\n");
+    return(11);
+  }
+  pack(&c, phase, step, h, Nrdfcalls);
+
+  sprintf(tmpfile, "%s.tmp", ckpt.file);
+  fp = fopen(tmpfile, "wb");
+  if (fp == NULL)
+  {
+    fprintf(stdout, "WARNING: the checkpoint file \"%s\" could not be opened.\n", tmpfile);
+    free(c.data);
+    return(0);
+  }
+  written = fwrite(c.data, 1, c.size, fp);
+#ifdef _WIN32
+  if (fclose(fp) == 0 && written == c.size) remove(ckpt.file); //rename does not replace on Windows
+  else written = 0;
+#else
+  if (fclose(fp) != 0) written = 0;
+#endif
+  if (written != c.size || rename(tmpfile, ckpt.file) != 0)
+    fprintf(stdout, "WARNING: the checkpoint file \"%s\" could not be written.\n", ckpt.file);
+  free(c.data);
+  return(0);
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function prints an error for a bad checkpoint file            */
+/* ------------------------------------------------------------------- */
+static int bad_checkpoint(unsigned char *data, const char *reason)
+{
+  fprintf(stdout, "The checkpoint file \"%s\" cannot be used: %s.\n", ckpt.restartfile, reason);
+  free(data);
+  return(ERROR_INPUT_FILE);
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function reads the checkpoint in ckpt.restartfile into the    */
+/*  simulation.  It must be called after the arrays and lists have     */
+/*  been allocated and initialized for the input file.  The rdf        */
+/*  histogram is kept until checkpoint_restore_rdf() is called.        */
+/* ------------------------------------------------------------------- */
+int checkpoint_read(void)
+{
+  struct ckpt_image c = {NULL, 0, 0};
+  char magic[8], type[4];
+  uint32_t version;
+  uint64_t n, u;
+  int32_t flag;
+  double length;
+  double *arrays[13];
+  int k, ncells;
+  long end;
+  FILE *fp;
+
+  /* ------------------------------------------------------------------- */
+  /*  Read the whole file with one fread                                 */
+  /* ------------------------------------------------------------------- */
+  fp = fopen(ckpt.restartfile, "rb");
+  if (fp == NULL)
+  {
+    fprintf(stdout, "The checkpoint file \"%s\" could not be opened.\n", ckpt.restartfile);
+    return(ERROR_FILE_NOT_FOUND);
+  }
+  fseek(fp, 0, SEEK_END);
+  end = ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+  if (end <= 0) { fclose(fp); return(bad_checkpoint(NULL, "it is empty")); }
+  c.size = (size_t)end;
+  c.data = (unsigned char*) malloc(c.size);
+  if (c.data == NULL)
+  {
+    fclose(fp);
+    fprintf(stdout, "ERROR: cannot allocate memory for the checkpoint\n");
+    return(11);
+  }
+  if (fread(c.data, 1, c.size, fp) != c.size) { fclose(fp); return(bad_checkpoint(c.data, "it could not be read")); }
+  fclose(fp);
+
+  /* ------------------------------------------------------------------- */
+  /*  Check that the checkpoint belongs to this input file               */
+  /* ------------------------------------------------------------------- */
+  if (!get(&c, magic, 8) || memcmp(magic, CKPT_MAGIC, 8)) return(bad_checkpoint(c.data, "it is not a checkpoint"));
+  if (!get(&c, &version, sizeof(version)) || version != CKPT_VERSION) return(bad_checkpoint(c.data, "its version is not supported"));
+  if (!get(&c, type, sizeof(type)) || strcmp(type, sim.type)) return(bad_checkpoint(c.data, "it is for a different simulation type"));
+  if (!get(&c, &n, sizeof(n)) || n != sim.N) return(bad_checkpoint(c.data, "it has a different number of particles"));
+  if (!get(&c, &flag, sizeof(flag))) return(bad_checkpoint(c.data, "it is truncated"));
+  ckpt.phase = flag;
+  if (!get(&c, &u, sizeof(u))) return(bad_checkpoint(c.data, "it is truncated"));
+  ckpt.step = (unsigned long)u;
+  if (!get(&c, &sim.dt, sizeof(double)) || !get(&c, &length, sizeof(double))) return(bad_checkpoint(c.data, "it is truncated"));
+  if (fabs(length - sim.length) > 1.0e-12*sim.length) return(bad_checkpoint(c.data, "it has a different box length"));
+  if ((ckpt.phase == 0 && ckpt.step > sim.eq) || (ckpt.phase == 1 && ckpt.step > sim.pr) || ckpt.phase < 0 || ckpt.phase > 1)
+    return(bad_checkpoint(c.data, "it is past the steps in the input file"));
+
+  /* ------------------------------------------------------------------- */
+  /*  Restore the state                                                  */
+  /* ------------------------------------------------------------------- */
+  arrays[0] = atom.x;   arrays[1] = atom.y;   arrays[2] = atom.z;
+  arrays[3] = atom.vx;  arrays[4] = atom.vy;  arrays[5] = atom.vz;
+  arrays[6] = atom.fx;  arrays[7] = atom.fy;  arrays[8] = atom.fz;
+  arrays[9] = atom.dx;  arrays[10] = atom.dy; arrays[11] = atom.dz;
+  arrays[12] = atom.pe;
+  if (!get(&c, &ran, sizeof(ran)) || !get(&c, &iprop, sizeof(iprop)) || !get(&c, &aprop, sizeof(aprop)))
+    return(bad_checkpoint(c.data, "it is truncated"));
+  for (k = 0; k < 13; k++)
+    if (!get(&c, arrays[k], sim.N*sizeof(double))) return(bad_checkpoint(c.data, "it is truncated"));
+
+  if (!get(&c, &flag, sizeof(flag))) return(bad_checkpoint(c.data, "it is truncated"));
+  if (flag)
+  {
+    if (!get(&c, &rdf_n, sizeof(int)) || rdf_n != sim.rdfN) return(bad_checkpoint(c.data, "its rdf has a different number of bins"));
+    rdf_bin = (double*) malloc(rdf_n*sizeof(double));
+    if (rdf_bin == NULL) return(bad_checkpoint(c.data, "there is not enough memory for its rdf"));
+    if (!get(&c, rdf_bin, rdf_n*sizeof(double)) || !get(&c, &rdf_calls, sizeof(double)))
+      return(bad_checkpoint(c.data, "it is truncated"));
+  }
+
+  if (!get(&c, &flag, sizeof(flag))) return(bad_checkpoint(c.data, "it is truncated"));
+  if (flag != (nlist.start != NULL)) return(bad_checkpoint(c.data, "it has a different neighbor list setting"));
+  if (flag)
+  {
+    if (!get(&c, &u, sizeof(u))) return(bad_checkpoint(c.data, "it is truncated"));
+    if (u > nlist.size)
+    {
+      nlist.size = (unsigned long)u;
+      nlist.list = (unsigned long*) realloc(nlist.list, nlist.size*sizeof(unsigned long));
+      if (nlist.list == NULL) return(bad_checkpoint(c.data, "there is not enough memory for its neighbor list"));
+    }
+    if (!get(&c, nlist.start, (sim.N + 1)*sizeof(unsigned long)) || !get(&c, nlist.list, u*sizeof(unsigned long)) ||
+        !get(&c, nlist.dx0, sim.N*sizeof(double)) || !get(&c, nlist.dy0, sim.N*sizeof(double)) ||
+        !get(&c, nlist.dz0, sim.N*sizeof(double)) || !get(&c, &nlist.rebuild, sizeof(int)) ||
+        !get(&c, &nlist.nbuild, sizeof(unsigned long)) || !get(&c, &nlist.npairs, sizeof(double)))
+      return(bad_checkpoint(c.data, "it is truncated"));
+  }
+
+  if (!get(&c, &flag, sizeof(flag))) return(bad_checkpoint(c.data, "it is truncated"));
+  if (flag != (mccells.grid.n >= 3)) return(bad_checkpoint(c.data, "it has a different MC cell list"));
+  if (flag)
+  {
+    if (!get(&c, &ncells, sizeof(int)) || ncells != mccells.grid.ncells) return(bad_checkpoint(c.data, "it has a different MC cell list"));
+    if (!get(&c, mccells.head, ncells*sizeof(long)) || !get(&c, mccells.next, sim.N*sizeof(long)) ||
+        !get(&c, mccells.prev, sim.N*sizeof(long)) || !get(&c, mccells.cell, sim.N*sizeof(unsigned long)) ||
+        !get(&c, &mccells.npairs, sizeof(double)) || !get(&c, &mccells.nskipped, sizeof(double)))
+      return(bad_checkpoint(c.data, "it is truncated"));
+  }
+
+  if (!get(&c, &domains.nsweep, sizeof(unsigned long))) return(bad_checkpoint(c.data, "it is truncated"));
+
+  free(c.data);
+  return(0);
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function copies the rdf of the checkpoint into h and the      */
+/*  number of accumulations into Nrdfcalls                             */
+/* ------------------------------------------------------------------- */
+void checkpoint_restore_rdf(tak_histogram *h, double *Nrdfcalls)
+{
+  if (h == NULL || rdf_bin == NULL) return;
+  memcpy(h->bin, rdf_bin, rdf_n*sizeof(double));
+  *Nrdfcalls = rdf_calls;
+  free(rdf_bin);
+  rdf_bin = NULL;
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function records the signal that asks the run to stop         */
+/* ------------------------------------------------------------------- */
+static void catch_stop(int sig)
+{
+  stop_signal = sig;
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function starts the walltime clock and installs the handlers  */
+/*  for SIGTERM and SIGUSR1                                            */
+/* ------------------------------------------------------------------- */
+void checkpoint_signals_install(void)
+{
+  stop_start = wall_clock();
+  stop_last = stop_start;
+  signal(SIGTERM, catch_stop);
+#ifdef SIGUSR1
+  signal(SIGUSR1, catch_stop);
+#endif
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function is called after every step and returns true if the   */
+/*  run should stop: a signal was caught or the time left in the       */
+/*  walltime budget is less than the longest step so far.              */
+/* ------------------------------------------------------------------- */
+bool checkpoint_stop(void)
+{
+  double now, step;
+
+  if (stop_signal) return(true);
+  if (ckpt.walltime <= 0.0) return(false);
+
+  now = wall_clock();
+  step = now - stop_last;
+  if (step > stop_step) stop_step = step;
+  stop_last = now;
+  return(now - stop_start + stop_step >= ckpt.walltime);
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function writes the checkpoint for a run that is stopped      */
+/*  early and sets sim.pr to the production steps done so that         */
+/*  finalize_file() writes the averages so far.  A checkpoint file is  */
+/*  named after the output file if none was given.                     */
+/* ------------------------------------------------------------------- */
+int checkpoint_exit(int phase, unsigned long step, tak_histogram *h, double Nrdfcalls)
+{
+  int return_flag;
+
+  if (ckpt.file[0] == '\0') snprintf(ckpt.file, sizeof(ckpt.file), "%.122s.ckpt", sim.outputfile);
+  return_flag = checkpoint_write(phase, step, h, Nrdfcalls);
+
+  if (stop_signal) output_log_printf("\nThe run was stopped by signal %d after %s step %lu.\n", (int)stop_signal, phase ? "production" : "equilibration", step);
+  else output_log_printf("\nThe run was stopped after %s step %lu because the walltime of %.0lf s was nearly used.\n", phase ? "production" : "equilibration", step, ckpt.walltime);
+  output_log_printf("A checkpoint was written to \"%s\"; add \"restart %s\" to the input file to continue.\n", ckpt.file, ckpt.file);
+  fprintf(stdout, "Stopped after %s step %lu; checkpoint written to \"%s\".\n", phase ? "production" : "equilibration", step, ckpt.file);
+
+  sim.pr = phase ? step : 0;
+  return(return_flag);
+}
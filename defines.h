@@ -30,6 +30,8 @@
 #define ERROR_INPUT_FILE 102
 #define ERROR_LINEAR_MOMENTUM 200
 #define MAX_LINE 1024
+#define LOG_LINE_SIZE 512
+#define ALIGN 64
 #define _CRT_SECURE_NO_WARNINGS
 
 #define PI 3.14159265359
@@ -60,6 +62,7 @@ struct sim_struct {
   unsigned int    output;               /* interval for output of instan. props */
   unsigned int    movie;                /* interval for movie frames            */
   char            moviefile[128];       /* name of movie file                   */
+  char            movieformat[4];       /* movie format: trr or xtc             */
   double          utail;                /* tail correction to energy            */
   double          ptail;                /* tail correction to pressure          */
   long            seed;                 /* seed to the random number generator  */
@@ -68,29 +71,43 @@ struct sim_struct {
   double          rdfmax;               /* maximum r value for rdf              */
   int             rdfN;                 /* number of bins for rdf               */
   unsigned int    rdf;                  /* frequency to accumulate the rdf      */
+  double          skin;                 /* skin of the md neighbor list         */
+  int             threads;              /* number of threads (0 = OpenMP value) */
+  unsigned int    sample;               /* interval for sampling mc properties  */
+  char            sweep[16];            /* mc sweep: serial or checkerboard     */
+  char            asyncio[16];          /* I/O thread: off, block, or drop      */
+  int             rates;                /* add rates to output lines if nonzero */
 } sim;
 
 /* ------------------------------------------------------------------- */
 /*  This structure contains information on the properties of each atom */
+/*  stored as separate arrays (structure of arrays) so that loops that */
+/*  only need positions do not load velocities and forces.  All of the */
+/*  arrays are carved from one block and aligned to ALIGN bytes.       */
 /* ------------------------------------------------------------------- */
 #ifndef MAIN
 extern
 #endif
 struct atom_struct {
-  double          x;                    /* x position                           */
-  double          y;                    /* y position                           */
-  double          z;                    /* z position                           */
-  double          vx;                   /* vx x velocity                        */
-  double          vy;                   /* vy y velocity                        */
-  double          vz;                   /* vz z velocity                        */
-  double          fx;                   /* ax x acceleration                    */
-  double          fy;                   /* ay y acceleration                    */
-  double          fz;                   /* az z acceleration                    */
-  double          dr2;                  /* MSD accumulator for diffusion (MD)   */
-  double          dx;                   /* x displacment for diffusion (MD)     */
-  double          dy;                   /* y displacment for diffusion (MD)     */
-  double          dz;                   /* z displacment for diffusion (MD)     */
-} *atom;
+  double          *x;                   /* x position                           */
+  double          *y;                   /* y position                           */
+  double          *z;                   /* z position                           */
+  double          *vx;                  /* vx x velocity                        */
+  double          *vy;                  /* vy y velocity                        */
+  double          *vz;                  /* vz z velocity                        */
+  double          *fx;                  /* ax x acceleration                    */
+  double          *fy;                  /* ay y acceleration                    */
+  double          *fz;                  /* az z acceleration                    */
+  double          *dx;                  /* x displacment for diffusion (MD)     */
+  double          *dy;                  /* y displacment for diffusion (MD)     */
+  double          *dz;                  /* z displacment for diffusion (MD)     */
+  double          *pe;                  /* pair energy of each atom (MC)        */
+  unsigned long   stride;               /* padded length of each array          */
+  void            *block;               /* memory block holding the arrays      */
+  int             nthreads;             /* number of force buffers (threads)    */
+  double          *tf;                  /* force buffers of threads 1 and up    */
+  void            *tblock;              /* memory block holding the buffers     */
+} atom;
 
 /* ------------------------------------------------------------------- */
 /*  This structure contains information on the simulation properties   */
@@ -106,7 +123,160 @@ struct props_struct {
   double          virial;               /* virial for pressure         */
   unsigned long   naccept;              /* number of mc moves accepted */
   unsigned long   ntrys;                /* number of mc moves tried    */
+  unsigned long   nsample;              /* number of samples averaged  */
   unsigned long   Nhist;
 } iprop, aprop;
 
+/* ------------------------------------------------------------------- */
+/*  This structure contains a linked-cell list.  The box is divided    */
+/*  into n*n*n cells with sides at least as long as the cutoff and the */
+/*  atoms are sorted by cell so that each cell's atoms are stored      */
+/*  contiguously in index[start[c]] to index[start[c+1]-1].            */
+/* ------------------------------------------------------------------- */
+#ifndef MAIN
+extern
+#endif
+struct cell_struct {
+  int             n;                    /* number of cells per side    */
+  int             ncells;               /* total number of cells       */
+  double          width;                /* length of a cell side       */
+  unsigned long   *start;               /* first entry of each cell    */
+  unsigned long   *index;               /* atoms sorted by cell        */
+  unsigned long   *cell;                /* cell of each atom           */
+} cells;
+
+/* ------------------------------------------------------------------- */
+/*  This structure contains the linked-cell list used in MC.  Each     */
+/*  cell holds a doubly linked list of its atoms so that an accepted   */
+/*  move can relink one atom without sorting.  Only the cell geometry  */
+/*  of grid is used.  jlist holds the atoms gathered for a trial move  */
+/*  and du the changes in their pair energies.  npairs and nskipped    */
+/*  count the pairs needed by the trial moves and those skipped by     */
+/*  early rejection.                                                   */
+/* ------------------------------------------------------------------- */
+#ifndef MAIN
+extern
+#endif
+struct mccell_struct {
+  struct cell_struct grid;              /* cell geometry               */
+  long            *head;                /* first atom of each cell     */
+  long            *next;                /* next atom in the same cell  */
+  long            *prev;                /* previous atom in same cell  */
+  unsigned long   *cell;                /* cell of each atom           */
+  unsigned long   *jlist;               /* atoms near a trial move     */
+  double          *du;                  /* pair energy changes         */
+  double          npairs;               /* pair energies needed        */
+  double          nskipped;             /* pair energies skipped       */
+} mccells;
 
+
+/* ------------------------------------------------------------------- */
+/*  This structure contains the state of one stream of the counter-    */
+/*  based generator in random_numbers.c.  The n-th number of a stream  */
+/*  depends only on key, id, and n.  The main stream is ran.           */
+/* ------------------------------------------------------------------- */
+#ifndef MAIN
+extern
+#endif
+struct ran_stream {
+  uint32_t        key[2];               /* key from the seed           */
+  uint64_t        id;                   /* stream id                   */
+  uint64_t        n;                    /* numbers drawn so far        */
+  double          next;                 /* second number of the block  */
+} ran;
+
+/* ------------------------------------------------------------------- */
+/*  This structure contains the domains of a checkerboard MC sweep.    */
+/*  The box is divided into n*n*n domains, n even, that are at least   */
+/*  two MC cells wide and are shifted by a random offset each sweep.   */
+/*  Domains whose indices have the same parities (color) never read or */
+/*  write the same cells during a trial move, so the domains of one    */
+/*  color are swept at the same time.  Each domain has its own random  */
+/*  stream and accumulators; each thread has its own scratch lists.    */
+/* ------------------------------------------------------------------- */
+#ifndef MAIN
+extern
+#endif
+struct domain_struct {
+  int             n;                    /* number of domains per side  */
+  int             ndomains;             /* total number of domains     */
+  double          width;                /* length of a domain side     */
+  double          offset[3];            /* shift of the domain grid    */
+  unsigned long   nsweep;               /* sweeps done                 */
+  unsigned long   *start;               /* first entry of each domain  */
+  unsigned long   *index;               /* atoms sorted by domain      */
+  unsigned long   *domain;              /* domain of each atom         */
+  struct ran_stream *rs;                /* stream of each domain       */
+  double          *dpe;                 /* energy change of domain     */
+  double          *dvirial;             /* virial change of domain     */
+  unsigned long   *naccept;             /* moves accepted in domain    */
+  unsigned long   *ntrys;               /* moves tried in domain       */
+  double          *npairs;              /* pair terms of domain        */
+  unsigned long   *jlist;               /* scratch atoms per thread    */
+  double          *du;                  /* scratch energies per thread */
+} domains;
+
+/* ------------------------------------------------------------------- */
+/*  This structure contains the checkpoint and restart settings.  A    */
+/*  checkpoint is written to file every interval steps and at the end  */
+/*  of the run.  If restart is nonzero the run continues from the      */
+/*  checkpoint in restartfile after step step of phase phase.  The run */
+/*  also stops with a checkpoint on SIGTERM or SIGUSR1 or when less    */
+/*  than a step of the walltime budget is left.                        */
+/* ------------------------------------------------------------------- */
+#ifndef MAIN
+extern
+#endif
+struct checkpoint_struct {
+  char            file[128];            /* checkpoint file to write    */
+  unsigned int    interval;             /* steps between checkpoints   */
+  char            restartfile[128];     /* checkpoint to restart from  */
+  int             restart;              /* nonzero when restarting     */
+  int             phase;                /* 0 equilibration, 1 prod.    */
+  unsigned long   step;                 /* last step of phase done     */
+  double          walltime;             /* time budget [s], 0 for none */
+} ckpt;
+
+/* ------------------------------------------------------------------- */
+/*  This structure contains the wall time spent in each part of the    */
+/*  run, measured with wall_clock(), and the work done.  pairs counts  */
+/*  the pair terms evaluated by the force pass and the MC trials.  An  */
+/*  rdf binned in the force pass is part of the force time.            */
+/* ------------------------------------------------------------------- */
+#ifndef MAIN
+extern
+#endif
+struct timer_struct {
+  double          start;                /* wall_clock() at the start   */
+  double          forces;               /* force evaluation [s]        */
+  double          integrate;            /* velocity Verlet update [s]  */
+  double          trial;                /* MC trial moves [s]          */
+  double          rdf;                  /* rdf accumulation [s]        */
+  double          trajectory;           /* trajectory frames [s]       */
+  double          log;                  /* output file lines [s]       */
+  double          pairs;                /* pair terms evaluated        */
+  double          mdsteps;              /* MD steps done               */
+  double          mctrials;             /* MC trial moves done         */
+} timers;
+
+/* ------------------------------------------------------------------- */
+/*  This structure contains the Verlet neighbor list used in MD.  The  */
+/*  neighbors j > i of atom i within rc+skin are stored in             */
+/*  list[start[i]] to list[start[i+1]-1].  The list is rebuilt when an */
+/*  atom has moved more than half the skin since the last build.       */
+/* ------------------------------------------------------------------- */
+#ifndef MAIN
+extern
+#endif
+struct nlist_struct {
+  double          rl2;                  /* square of the list radius   */
+  unsigned long   *start;               /* first neighbor of each atom */
+  unsigned long   *list;                /* neighbors of all atoms      */
+  unsigned long   size;                 /* allocated length of list    */
+  double          *dx0;                 /* x displacement at build     */
+  double          *dy0;                 /* y displacement at build     */
+  double          *dz0;                 /* z displacement at build     */
+  int             rebuild;              /* force a rebuild if nonzero  */
+  unsigned long   nbuild;               /* number of builds            */
+  double          npairs;               /* accumulated pairs at builds */
+} nlist;
@@ -24,6 +24,16 @@
 #include "includes.h"
 
 int rdf_finalize(tak_histogram*, double);
+void cell_list_free(struct cell_struct*);
+void mc_cell_list_free(void);
+void checkerboard_free(void);
+void neighbor_list_free(void);
+void rdf_free(void);
+FILE* output_log_file(void);
+void write_trr_close(void);
+void async_io_stop(void);
+unsigned long async_io_dropped(void);
+void timers_write(FILE*);
 
 int finalize_file(tak_histogram *h, double Nrdfcalls)
 {
@@ -32,6 +42,7 @@ int finalize_file(tak_histogram *h, double Nrdfcalls)
   double pr = (double)sim.pr;
   double N = (double)sim.N;
   unsigned long i;
+  bool sampled = !(!strcmp(sim.type, "mc") && sim.sample && aprop.nsample == 0); //false if stopped before the first sample
 
   /* ------------------------------------------------------------------- */
   /*  Calculate the simple averages                                      */
@@ -46,6 +57,12 @@ int finalize_file(tak_histogram *h, double Nrdfcalls)
     ke = aprop.ke / pr;
     T = aprop.T / pr;
   }
+  else if (sim.sample)
+  {
+    pe = aprop.pe / (double)aprop.nsample;       //one sample per sampling interval
+    pe2 = aprop.pe2 / (double)aprop.nsample;
+    virial = aprop.virial / (double)aprop.nsample;
+  }
   else
   {
     pe = pe / N;           //Divide by N here because each production step
@@ -64,24 +81,25 @@ int finalize_file(tak_histogram *h, double Nrdfcalls)
   /*  Calculate diffusion from MSD                                       */
   /* ------------------------------------------------------------------- */
   Dmsd = 0.0;
-  for (i = 0; i < sim.N; i++) Dmsd += atom[i].dx*atom[i].dx+ atom[i].dy*atom[i].dy+ atom[i].dz*atom[i].dz;
+  for (i = 0; i < sim.N; i++) Dmsd += atom.dx[i]*atom.dx[i]+ atom.dy[i]*atom.dy[i]+ atom.dz[i]*atom.dz[i];
   Dmsd = Dmsd / pr / N / 6 / sim.dt;
 
   /* ------------------------------------------------------------------- */
   /*  Write the data to file                                             */
   /* ------------------------------------------------------------------- */
-  fp = fopen(sim.outputfile, "a");
+  async_io_stop();
+  fp = output_log_file();
 
   fprintf(fp, "\n    ***FINAL POSITIONS, XYZ Format***\n");
   fprintf(fp, "%lu\nYou can copy these coordinates to a file to open in a viewer.\n", sim.N);
-  for (i = 0; i<sim.N; i++) fprintf(fp, "C\t%13.6lf\t%13.6lf\t%13.6lf\n", atom[i].x, atom[i].y, atom[i].z);
+  for (i = 0; i<sim.N; i++) fprintf(fp, "C\t%13.6lf\t%13.6lf\t%13.6lf\n", atom.x[i], atom.y[i], atom.z[i]);
   if (!strcmp(sim.type, "md"))
   {
     fprintf(fp, "\n         ***FINAL VELOCITIES***\n");
-    for (i = 0; i < sim.N; i++) fprintf(fp, "\t%13.6lf\t%13.6lf\t%13.6lf\n", atom[i].vx, atom[i].vy, atom[i].vz);
+    for (i = 0; i < sim.N; i++) fprintf(fp, "\t%13.6lf\t%13.6lf\t%13.6lf\n", atom.vx[i], atom.vy[i], atom.vz[i]);
   }
 
-  if (sim.rdf)
+  if (sim.rdf && h != NULL) //a run stopped during equilibration has no rdf
   {
     fprintf(fp, "\n***Radial Distribution Function***\n\n");
     rdf_finalize(h, Nrdfcalls);
@@ -89,7 +107,7 @@ int finalize_file(tak_histogram *h, double Nrdfcalls)
     tak_histogram_free(h);
   }
 
-  if (sim.pr > 0)
+  if (sim.pr > 0 && sampled)
   {
     fprintf(fp, "\n***Simulation Averages***\n\n");
     fprintf(fp, "Temperature:              %10.6lf\n", T);
@@ -102,6 +120,12 @@ int finalize_file(tak_histogram *h, double Nrdfcalls)
       fprintf(fp, "Total Energy:             %10.6lf\n", ((ke + pe) / N)+sim.utail);
       fprintf(fp, "Diffusivity:              %10.6lf\n\n", Dmsd);
     }
+    if (nlist.start != NULL)
+    {
+      fprintf(fp, "Neighbor List Skin:       %10.6lf\n", sim.skin);
+      fprintf(fp, "Neighbor List Rebuilds:   %10lu\n", nlist.nbuild);
+      fprintf(fp, "Average Neighbors/Atom:   %10.6lf\n\n", 2.0 * nlist.npairs / (double)nlist.nbuild / N);
+    }
     if (!strcmp(sim.type, "mc"))
     {
         if (aprop.ntrys != 0)
@@ -109,14 +133,25 @@ int finalize_file(tak_histogram *h, double Nrdfcalls)
             fprintf(fp, "Move Acceptance Rate:     %10.6lf\n", (double)aprop.naccept / (double)aprop.ntrys);
             fprintf(fp, "Final Max Displacement:   %10.6lf\n\n", sim.dt);
         }
+        if (mccells.npairs > 0.0)
+            fprintf(fp, "Pair Evaluations Saved:   %10.6lf\n\n", mccells.nskipped / mccells.npairs);
     }
+    if (!strcmp(sim.asyncio, "drop") && sim.movie)
+      fprintf(fp, "Trajectory Frames Dropped: %9lu\n\n", async_io_dropped());
     
   }
+  else if (sim.pr > 0) fprintf(fp, "\nNo production steps were sampled, so simulation averages were not calculated.\n\n");
   else fprintf(fp, "\nNo productions steps were specified, so simulation averages were not calculated.\n\n");
-  
-  fclose(fp);
+  timers_write(fp);
 
-  free(atom);
+  write_trr_close();
+  free(atom.block);
+  free(atom.tblock);
+  cell_list_free(&cells);
+  if (nlist.start != NULL) neighbor_list_free();
+  rdf_free();
+  mc_cell_list_free();
+  if (domains.n > 0) checkerboard_free();
 
   return(0);
 }
\ No newline at end of file
@@ -18,105 +18,313 @@
 /* forces.c                                                                 */
 /*                                                                          */
 /* This function calculates the energies and forces between each Lennard    */
-/* Jones particle.  It returns the potential energy.                        */
+/* Jones particle.  It returns the potential energy.  In MD the pairs come  */
+/* from the Verlet neighbor list.  Otherwise a linked-cell list is used     */
+/* when the box holds at least 3 cells per side, and every pair of          */
+/* particles is visited when it does not.  The pairs are computed by the    */
+/* kernels in lj_kernel.c and are split over OpenMP threads, each with its  */
+/* own force buffer.                                                        */
+/*                                                                          */
+/* forces_verlet() performs a whole velocity Verlet step in the same pass.  */
+/* The first half kick, drift, and periodic wrap are done before the pairs  */
+/* and the second half kick and kinetic energy are done while the thread    */
+/* buffers are summed, so an MD step reads the atom arrays fewer times.     */
+/* On rdf sampling steps it can also bin the pair distances, which needs    */
+/* every pair within rdfmax to be in the pass (rdfmax <= rc).               */
 /* ======================================================================== */
 
 #include "includes.h"
 
-double forces(void)
+void          cell_list_build(struct cell_struct*);
+unsigned long cell_list_neighbor(struct cell_struct*, unsigned long, int, int, int);
+void          neighbor_list_update(void);
+void          neighbor_list_build(void);
+double        lj_force_range(unsigned long, unsigned long, unsigned long, double*, double*, double*, double*, tak_histogram*);
+double        lj_force_list(unsigned long, const unsigned long*, unsigned long, double*, double*, double*, double*, tak_histogram*);
+double        wall_clock(void);
+tak_histogram* rdf_thread_histogram(int);
+
+/* ------------------------------------------------------------------- */
+/*  The 13 neighbor cells in the forward half of the 26 surrounding    */
+/*  cells.  Visiting only these counts each pair of cells once.        */
+/* ------------------------------------------------------------------- */
+static const int half_shell[13][3] = {
+  { 1, 0, 0}, { 1, 1, 0}, { 0, 1, 0}, {-1, 1, 0},
+  { 1, 0, 1}, { 1, 1, 1}, { 0, 1, 1}, {-1, 1, 1},
+  { 1,-1, 1}, { 0,-1, 1}, {-1,-1, 1}, { 0, 0, 1}, {-1, 0, 1} };
+
+/* ------------------------------------------------------------------- */
+/*  This function returns the number of pairs visited by the last      */
+/*  force pass, which is counted in timers.pairs.                      */
+/* ------------------------------------------------------------------- */
+static double pairs_visited(void)
 {
-  double dr2, d2, d4, d8, d14;
-	double dx, dy, dz;
-	double fr;
-	double virial = 0.0;
-	double pe = 0.0;
-	unsigned long i,j;
+  unsigned long c, cn, nc;
+  double n = 0.0;
+  int k;
+
+  if (nlist.start != NULL) return((double)nlist.start[sim.N]);
+  if (cells.n < 3) return(0.5*(double)sim.N*(double)(sim.N - 1));
+  for (c = 0; c < (unsigned long)cells.ncells; c++)
+  {
+    nc = cells.start[c+1] - cells.start[c];
+    n += 0.5*(double)nc*(double)(nc - 1);
+    for (k = 0; k < 13; k++)
+    {
+      cn = cell_list_neighbor(&cells, c, half_shell[k][0], half_shell[k][1], half_shell[k][2]);
+      n += (double)nc*(double)(cells.start[cn+1] - cells.start[cn]);
+    }
+  }
+  return(n);
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function computes the forces and returns the potential        */
+/*  energy.  If step is true the positions and velocities are advanced */
+/*  by one velocity Verlet step around the force calculation, and the  */
+/*  kinetic energy at the end of the step is stored in ke.  If h is    */
+/*  not NULL the pair distances are binned in the rdf histogram h.     */
+/* ------------------------------------------------------------------- */
+static double force_pass(bool step, double *ke, tak_histogram *h)
+{
+  double virial = 0.0;
+  double pe = 0.0;
+  double kinetic = 0.0;
+  double dr2max = 0.0;
+  double t_start, t_drift = 0.0, t_kick = 0.0, t_end, t_step = 0.0;
 
   /* ------------------------------------------------------------------- */
-  /*  Zero out the force accumulators                                    */
-  /* ------------------------------------------------------------------- */
-	for(i=0; i<sim.N; i++)
-	{
-		atom[i].fx = 0.0;
-		atom[i].fy = 0.0;
-		atom[i].fz = 0.0;
-	}
-	
-  /* ------------------------------------------------------------------- */
-  /*  Calculate the forces by looping over all pairs of sites            */
+  /*  Each thread accumulates the forces in its own buffer so that both  */
+  /*  atoms of a pair can be updated without atomics.  The buffers are   */
+  /*  summed into fx, fy, and fz at the end.  Thread 0 reads the clock   */
+  /*  after the first half of the step and before the second half, when  */
+  /*  every thread has finished the part before.                         */
   /* ------------------------------------------------------------------- */
-	for(i=0; i<sim.N-1; i++)
-	{
-		for(j=i+1; j<sim.N; j++)
-		{
-      dx = atom[i].x - atom[j].x;
-      dy = atom[i].y - atom[j].y;
-      dz = atom[i].z - atom[j].z;
-
-      /* ============================================ */
-      /*         Minimum Image Convention             */
-      /* ============================================ */
-      if (fabs(dx)>(sim.length*0.5))
+  t_start = wall_clock();
+#pragma omp parallel reduction(+:pe, virial, kinetic)
+  {
+    unsigned long i, c, cn, a;
+    int k, t = 0, nt = 1;
+    double *fx, *fy, *fz;
+    double dx, dy, dz, ddx, ddy, ddz;
+    tak_histogram *rdf = NULL;
+
+#ifdef _OPENMP
+    t = omp_get_thread_num();
+    nt = omp_get_num_threads();
+#endif
+
+    /* ------------------------------------------------------------------- */
+    /*  First half of the velocity Verlet step.  Update the positions to   */
+    /*  the full step and the velocities to the half step, apply periodic  */
+    /*  boundary conditions, and find the largest displacement since the   */
+    /*  neighbor list was built.  The old forces are zeroed once used.     */
+    /* ------------------------------------------------------------------- */
+    if (step)
+    {
+#pragma omp for schedule(static) reduction(max:dr2max)
+      for (i = 0; i < sim.N; i++)
       {
-        if (dx < 0.0)
-          dx += sim.length;
-        else
-          dx -= sim.length;
+        dx = sim.dt*atom.vx[i] + sim.dt*sim.dt*atom.fx[i] / 2.0;
+        dy = sim.dt*atom.vy[i] + sim.dt*sim.dt*atom.fy[i] / 2.0;
+        dz = sim.dt*atom.vz[i] + sim.dt*sim.dt*atom.fz[i] / 2.0;
+        atom.x[i] = atom.x[i] + dx;
+        atom.y[i] = atom.y[i] + dy;
+        atom.z[i] = atom.z[i] + dz;
+        atom.dx[i] += dx; //displacement accumulator for diffusivity
+        atom.dy[i] += dy;
+        atom.dz[i] += dz;
+
+        if (atom.x[i] < 0) atom.x[i] += sim.length;
+        else if (atom.x[i] > sim.length) atom.x[i] -= sim.length;
+        if (atom.y[i] < 0) atom.y[i] += sim.length;
+        else if (atom.y[i] > sim.length) atom.y[i] -= sim.length;
+        if (atom.z[i] < 0) atom.z[i] += sim.length;
+        else if (atom.z[i] > sim.length) atom.z[i] -= sim.length;
+
+        atom.vx[i] = atom.vx[i] + sim.dt*atom.fx[i]/2.0;
+        atom.vy[i] = atom.vy[i] + sim.dt*atom.fy[i]/2.0;
+        atom.vz[i] = atom.vz[i] + sim.dt*atom.fz[i]/2.0;
+        atom.fx[i] = 0.0;
+        atom.fy[i] = 0.0;
+        atom.fz[i] = 0.0;
+
+        if (nlist.start != NULL)
+        {
+          ddx = atom.dx[i] - nlist.dx0[i];
+          ddy = atom.dy[i] - nlist.dy0[i];
+          ddz = atom.dz[i] - nlist.dz0[i];
+          if (ddx*ddx + ddy*ddy + ddz*ddz > dr2max) dr2max = ddx*ddx + ddy*ddy + ddz*ddz;
+        }
       }
-      if (fabs(dy)>(sim.length*0.5))
+      if (t == 0) t_drift = wall_clock();
+    }
+
+    /* ------------------------------------------------------------------- */
+    /*  Zero out the force accumulators                                    */
+    /* ------------------------------------------------------------------- */
+    fx = (t == 0) ? atom.fx : atom.tf + 3*(t - 1)*atom.stride;
+    fy = (t == 0) ? atom.fy : fx + atom.stride;
+    fz = (t == 0) ? atom.fz : fx + 2*atom.stride;
+    if (!step || t > 0)
+    {
+      for(i=0; i<sim.N; i++)
       {
-        if (dy < 0.0)
-          dy += sim.length;
-        else
-          dy -= sim.length;
+        fx[i] = 0.0;
+        fy[i] = 0.0;
+        fz[i] = 0.0;
       }
+    }
 
-      if (fabs(dz)>(sim.length*0.5))
+    /* ------------------------------------------------------------------- */
+    /*  Thread 0 bins the rdf in h and the others in their own histograms  */
+    /* ------------------------------------------------------------------- */
+    if (h != NULL) rdf = (t == 0) ? h : rdf_thread_histogram(t);
+
+    /* ------------------------------------------------------------------- */
+    /*  Bring the neighbor or cell list up to date                         */
+    /* ------------------------------------------------------------------- */
+#pragma omp single
+    {
+      if (nlist.start != NULL)
       {
-        if (dz < 0.0)
-          dz += sim.length;
+        if (!step) neighbor_list_update();
         else
-          dz -= sim.length;
+        {
+          if (dr2max > 0.25*sim.skin*sim.skin) nlist.rebuild = 1;
+          if (nlist.rebuild) neighbor_list_build();
+        }
+      }
+      else if (cells.n >= 3) cell_list_build(&cells);
+    }
+
+    /* ------------------------------------------------------------------- */
+    /*  Calculate the forces from the neighbor list if it is being used    */
+    /* ------------------------------------------------------------------- */
+    if (nlist.start != NULL)
+    {
+#pragma omp for schedule(dynamic, 64)
+      for (i = 0; i < sim.N; i++)
+      {
+        pe += lj_force_list(i, &nlist.list[nlist.start[i]], nlist.start[i+1] - nlist.start[i], fx, fy, fz, &virial, rdf);
+      }
+    }
+
+    /* ------------------------------------------------------------------- */
+    /*  Calculate the forces by looping over all pairs of sites when the   */
+    /*  box is too small for a cell list                                   */
+    /* ------------------------------------------------------------------- */
+    else if (cells.n < 3)
+    {
+#pragma omp for schedule(dynamic, 16)
+      for(i=0; i<sim.N-1; i++) pe += lj_force_range(i, i+1, sim.N, fx, fy, fz, &virial, rdf);
+    }
+
+    /* ------------------------------------------------------------------- */
+    /*  Otherwise, calculate the forces by looping over the pairs in each  */
+    /*  cell and in the half shell of neighboring cells                    */
+    /* ------------------------------------------------------------------- */
+    else
+    {
+#pragma omp for schedule(dynamic, 4)
+      for (c = 0; c < (unsigned long)cells.ncells; c++)
+      {
+        for (a = cells.start[c]; a < cells.start[c+1]; a++)
+        {
+          i = cells.index[a];
+
+          /* ============================================ */
+          /*  Pairs within the same cell                  */
+          /* ============================================ */
+          pe += lj_force_list(i, &cells.index[a+1], cells.start[c+1] - a - 1, fx, fy, fz, &virial, rdf);
+
+          /* ============================================ */
+          /*  Pairs with the half shell of neighbors      */
+          /* ============================================ */
+          for (k = 0; k < 13; k++)
+          {
+            cn = cell_list_neighbor(&cells, c, half_shell[k][0], half_shell[k][1], half_shell[k][2]);
+            pe += lj_force_list(i, &cells.index[cells.start[cn]], cells.start[cn+1] - cells.start[cn], fx, fy, fz, &virial, rdf);
+          }
+        }// a
+      }// c
+    }
+
+    /* ------------------------------------------------------------------- */
+    /*  Sum the thread buffers into the force arrays.  For a step, also    */
+    /*  update the velocities to the full step and sum the kinetic energy. */
+    /* ------------------------------------------------------------------- */
+    if (step && t == 0) t_kick = wall_clock();
+    if (nt > 1 || step)
+    {
+#pragma omp for schedule(static)
+      for (i = 0; i < sim.N; i++)
+      {
+        for (k = 1; k < nt; k++)
+        {
+          atom.fx[i] += atom.tf[3*(k - 1)*atom.stride + i];
+          atom.fy[i] += atom.tf[(3*(k - 1) + 1)*atom.stride + i];
+          atom.fz[i] += atom.tf[(3*(k - 1) + 2)*atom.stride + i];
+        }
+        if (step)
+        {
+          atom.vx[i] = atom.vx[i] + sim.dt*atom.fx[i]/2.0;
+          atom.vy[i] = atom.vy[i] + sim.dt*atom.fy[i]/2.0;
+          atom.vz[i] = atom.vz[i] + sim.dt*atom.fz[i]/2.0;
+          kinetic += 0.5*(atom.vx[i]*atom.vx[i] + atom.vy[i]*atom.vy[i] + atom.vz[i]*atom.vz[i]);
+        }
       }
+    }
 
-      dr2 = dx*dx + dy*dy + dz*dz;
-
-      /* ============================================ */
-      /*         Distance and Energy Calculation      */
-      /* ============================================ */
-			if (dr2 < sim.rc2)
-			{
-        d2 = 1.0 / dr2;
-				d4 = d2*d2;
-				d8 = d4*d4;
-				d14 = d8*d4*d2;
-				fr = 48.0*(d14-0.5*d8);
-				
-				//components of forces
-				atom[i].fx += fr*dx;
-				atom[i].fy += fr*dy;
-				atom[i].fz += fr*dz;
-				atom[j].fx -= fr*dx;
-				atom[j].fy -= fr*dy;
-				atom[j].fz -= fr*dz;
-			
-				//viral and potential energy
-				virial += dr2*fr;
-				pe  += 4.0*(d14-d8)*dr2;
-
-			}//if for sim.rc2 
-		}// j
-	}// i
+    /* ------------------------------------------------------------------- */
+    /*  Add the rdf counts of the other threads to h                       */
+    /* ------------------------------------------------------------------- */
+    if (h != NULL && t > 0)
+    {
+#pragma omp critical
+      tak_histogram_merge(h, rdf);
+    }
+  }
+
+  /* ------------------------------------------------------------------- */
+  /*  Add the time and the pairs of the pass to the timers               */
+  /* ------------------------------------------------------------------- */
+  t_end = wall_clock();
+  if (step)
+  {
+    t_step = (t_drift - t_start) + (t_end - t_kick);
+    timers.integrate += t_step;
+    timers.mdsteps += 1.0;
+  }
+  timers.forces += t_end - t_start - t_step;
+  timers.pairs += pairs_visited();
 
    /* ------------------------------------------------------------------- */
    /*  Assign the instantaneous virial value                              */
    /* ------------------------------------------------------------------- */
-	iprop.virial = virial;
+  iprop.virial = virial;
+  if (step) *ke = kinetic;
 
   return(pe);
-}	
-
-
-
+}
 
+/* ------------------------------------------------------------------- */
+/*  This function calculates the forces and returns the potential      */
+/*  energy.                                                            */
+/* ------------------------------------------------------------------- */
+double forces(void)
+{
+  return(force_pass(false, NULL, NULL));
+}
 
+/* ------------------------------------------------------------------- */
+/*  This function advances the system by one velocity Verlet step.  It */
+/*  is the same as verlet1(), forces(), verlet2(), and                 */
+/*  kinetic_energy() called in turn.  It returns the potential energy  */
+/*  and stores the kinetic energy in ke.  If h is not NULL the pairs   */
+/*  within rdfmax are also binned in h; rdfmax must not exceed rc.     */
+/* ------------------------------------------------------------------- */
+double forces_verlet(double *ke, tak_histogram *h)
+{
+  return(force_pass(true, ke, h));
+}
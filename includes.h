@@ -23,6 +23,7 @@
 /* This file needs to be included at the top of each program file.          */
 /* ======================================================================== */
 
+#include <stdint.h>
 #include "defines.h"
 #include <stdio.h>
 #include <string.h>
@@ -30,5 +31,9 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <time.h>
+#include <signal.h>
 #include <ctype.h>
 #include "tak_histogram.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
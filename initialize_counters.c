@@ -37,6 +37,7 @@ int initialize_counters(void)
   aprop.pe2 = 0.0;
   aprop.ke = 0.0;
   aprop.virial = 0.0;
+  aprop.nsample = 0;
   if (!strcmp(sim.type, "mc"))
   {
     iprop.ntrys = 0;
@@ -50,10 +51,9 @@ int initialize_counters(void)
   /* ------------------------------------------------------------------- */
   for (unsigned long i = 0; i < sim.N; i++)
   {
-    atom[i].dr2 = 0.0;
-    atom[i].dx = 0.0;
-    atom[i].dy = 0.0;
-    atom[i].dz = 0.0;
+    atom.dx[i] = 0.0;
+    atom.dy[i] = 0.0;
+    atom.dz[i] = 0.0;
   }
 
   /* ------------------------------------------------------------------- */
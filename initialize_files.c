@@ -17,11 +17,15 @@
 /* ======================================================================== */
 /* initialize_files.c                                                       */
 /*                                                                          */
-/* This function initializes the output and movie files.                    */
+/* This function initializes the output and movie files.  A restarted run   */
+/* appends to both, and only a line that records the restart is added to    */
+/* the output file, so the log continues from the interrupted run.          */
 /* ======================================================================== */
 
 #include "includes.h"
 
+const char* lj_kernel_name(void);
+
 int initialize_files(char* input_errors)
 {
 
@@ -33,7 +37,7 @@ int initialize_files(char* input_errors)
   /*  Initialize movie file.                                             */
   /* ------------------------------------------------------------------- */
 
-	if (sim.movie) //if want movie
+	if (sim.movie && !ckpt.restart) //if want movie; a restarted run appends to it
     {
     //reinitialize file 
     fp = fopen(sim.moviefile, "w");
@@ -43,10 +47,27 @@ int initialize_files(char* input_errors)
     sscanf(sim.moviefile, "%[^.]", fileprefix);
     fp = fopen(strcat(fileprefix,".xyz"), "w");
     fprintf(fp, "%lu\nLoad this file in VMD before the .trr file\n", sim.N);
-    for (i = 0; i<sim.N; i++) fprintf(fp, "C\t%13.6lf\t%13.6lf\t%13.6lf\n", atom[i].x, atom[i].y, atom[i].z);
+    for (i = 0; i<sim.N; i++) fprintf(fp, "C\t%13.6lf\t%13.6lf\t%13.6lf\n", atom.x[i], atom.y[i], atom.z[i]);
     fclose(fp);
     }
 
+  /* ------------------------------------------------------------------- */
+  /* A restarted run continues the output file of the interrupted run    */
+  /* ------------------------------------------------------------------- */
+  if (ckpt.restart)
+  {
+    fp = fopen(sim.outputfile, "a");
+    if (fp == NULL)
+    {
+      fprintf(stdout, "ERROR: cannot open output file \"%s\"\n", sim.outputfile);
+      return(ERROR_FILE_NOT_FOUND);
+    }
+    fprintf(fp, "%s", input_errors);
+    fprintf(fp, "\nRestarted from checkpoint \"%s\" after %s step %lu.\n\n", ckpt.restartfile, ckpt.phase ? "production" : "equilibration", ckpt.step);
+    fclose(fp);
+    return(0);
+  }
+
   /* ------------------------------------------------------------------- */
   /* Write initial positions and velocities to the output file           */
   /* ------------------------------------------------------------------- */
@@ -70,28 +91,44 @@ int initialize_files(char* input_errors)
   fprintf(fp, "dt          %lf\n", sim.dt);
   fprintf(fp, "coord       %s\n", sim.icoord);
   if(!strcmp(sim.type,"md")) fprintf(fp, "vel         %s\n", sim.ivel);
+  if(!strcmp(sim.type,"md")) fprintf(fp, "skin        %lf\n", sim.skin);
   if (!(sim.movie == 0)) fprintf(fp, "movie       %s  %u\n", sim.moviefile, sim.movie);
   if (!(sim.rdf == 0)) fprintf(fp, "rdf         %lf  %lf  %d  %u\n", sim.rdfmin, sim.rdfmax, sim.rdfN, sim.rdf);
   if(!strcmp("generate", sim.seedkeyvalue)) fprintf(fp, "seed        %s\n", sim.seedkeyvalue);
   else fprintf(fp, "seed        %ld\n", sim.seed);
+  if (sim.threads > 0) fprintf(fp, "threads     %d\n", sim.threads);
+  if(!strcmp(sim.type,"mc") && sim.sample > 0) fprintf(fp, "sample      %u\n", sim.sample);
+  if(!strcmp(sim.type,"mc") && strcmp(sim.sweep, "serial")) fprintf(fp, "sweep       %s\n", sim.sweep);
+  if (strcmp(sim.asyncio, "off")) fprintf(fp, "asyncio     %s\n", sim.asyncio);
+  if (sim.rates) fprintf(fp, "rates       on\n");
+  if (ckpt.file[0] != '\0') fprintf(fp, "checkpoint  %s  %u\n", ckpt.file, ckpt.interval);
+  if (ckpt.walltime > 0.0) fprintf(fp, "walltime    %.0lf\n", ckpt.walltime);
   fprintf(fp, "output      %u\n\n", sim.output);
   fprintf(fp, "    ***Calculated Parameters***\n");
   fprintf(fp, "Box Length:                 %lf\n", sim.length);
   fprintf(fp, "Half Box Length:            %lf\n", sim.length*0.5);
   fprintf(fp, "Energy Tail Correction:    %lf\n", sim.utail);
   fprintf(fp, "Pressure Tail Correction:  %lf\n", sim.ptail);
+  fprintf(fp, "Pair Kernel:                %s\n", lj_kernel_name());
+  fprintf(fp, "Threads:                    %d\n", atom.nthreads);
+  if (!strcmp(sim.sweep, "checkerboard"))
+  {
+    if (domains.n > 0) fprintf(fp, "Checkerboard Domains/Side:  %d\n", domains.n);
+    else fprintf(fp, "Checkerboard Domains/Side:  none, the box is too small for 4 per side; serial sweeps are used\n");
+  }
 
   fprintf(fp, "\n    ***INITIAL POSITIONS, XYZ Format***\n");
   fprintf(fp,"%lu\nYou can copy these coordinates to a file to open in a viewer.\n",sim.N);
-	for (i=0; i<sim.N; i++) fprintf(fp, "C\t%13.6lf\t%13.6lf\t%13.6lf\n",atom[i].x, atom[i].y, atom[i].z);
+	for (i=0; i<sim.N; i++) fprintf(fp, "C\t%13.6lf\t%13.6lf\t%13.6lf\n",atom.x[i], atom.y[i], atom.z[i]);
 
   if (!strcmp(sim.type, "md"))
   {
     fprintf(fp, "\n         ***INITIAL VELOCITIES***\n");
-    for (i = 0; i < sim.N; i++) fprintf(fp, "\t%13.6lf\t%13.6lf\t%13.6lf\n", atom[i].vx, atom[i].vy, atom[i].vz);
-    fprintf(fp, "\n\nIteration                T              T Ave.              P             P Ave.             KE               PE               TE\n\n");
+    for (i = 0; i < sim.N; i++) fprintf(fp, "\t%13.6lf\t%13.6lf\t%13.6lf\n", atom.vx[i], atom.vy[i], atom.vz[i]);
+    fprintf(fp, "\n\nIteration                T              T Ave.              P             P Ave.             KE               PE               TE%s\n\n",
+            sim.rates ? "          Steps/s          Pairs/s" : "");
   }
-  else   fprintf(fp, "\n\nIteration                P              P Ave.             PE\n\n");
+  else   fprintf(fp, "\n\nIteration                P              P Ave.             PE%s\n\n", sim.rates ? "         Sweeps/s          Pairs/s" : "");
 
   fclose(fp);
 
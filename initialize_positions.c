@@ -21,22 +21,22 @@
 /* If the user specifies a coordinate file in the input file, the           */
 /* coordinates are read in.  Otherwise, they are generated as an FCC        */
 /* lattice.  The FCC approach is the default behavior.                      */
+/* The file is read by read_vectors() and may be text or binary.            */
 /* ======================================================================== */
 
 #include "includes.h"
 
-bool readline(char*, int, FILE*);
+int read_vectors(const char*, double*, double*, double*, unsigned long, unsigned long*, unsigned long*);
 
 int initialize_positions(char* fn_c, char* fn_i )
 {
   int nlin; //number of lines needed on each side of the box
   double a; //length of simulation box side, length of one unit cell
   int particle; //counter for the number of particles
-  char ch, buff[MAX_LINE];
+  char ch;
   int xdir, ydir, zdir;
-  unsigned long i;
-  FILE *fp;
-  bool read_flag;
+  unsigned long i, N, bad; //number of coordinates read, first bad line
+  int return_flag;
   
   sim.length = pow(((double)sim.N / sim.rho), 1.0 / 3.0);
  
@@ -74,34 +74,34 @@ int initialize_positions(char* fn_c, char* fn_i )
             if (particle == sim.N) return(0);
             switch (ch) {
             case '0':
-              atom[particle].x = 0.0 + (double)xdir*a;
-              atom[particle].y = 0.0 + (double)ydir*a;
-              atom[particle].z = 0.0 + (double)zdir*a;
+              atom.x[particle] = 0.0 + (double)xdir*a;
+              atom.y[particle] = 0.0 + (double)ydir*a;
+              atom.z[particle] = 0.0 + (double)zdir*a;
               ch = '1';
               particle++;
 
               break;
             case '1':
 
-              atom[particle].x = 0.0 + (double)xdir*a;
-              atom[particle].y = 0.5*a + (double)ydir*a;
-              atom[particle].z = 0.5*a + (double)zdir*a;
+              atom.x[particle] = 0.0 + (double)xdir*a;
+              atom.y[particle] = 0.5*a + (double)ydir*a;
+              atom.z[particle] = 0.5*a + (double)zdir*a;
               ch = '2';
               particle++;
 
               break;
             case '2':
-              atom[particle].x = 0.5*a + (double)xdir*a;
-              atom[particle].y = 0.0 + (double)ydir*a;
-              atom[particle].z = 0.5*a + (double)zdir*a;
+              atom.x[particle] = 0.5*a + (double)xdir*a;
+              atom.y[particle] = 0.0 + (double)ydir*a;
+              atom.z[particle] = 0.5*a + (double)zdir*a;
               ch = '3';
               particle++;
 
               break;
             case '3':
-              atom[particle].x = 0.5*a + (double)xdir*a;
-              atom[particle].y = 0.5*a + (double)ydir*a;
-              atom[particle].z = 0.0 + (double)zdir*a;
+              atom.x[particle] = 0.5*a + (double)xdir*a;
+              atom.y[particle] = 0.5*a + (double)ydir*a;
+              atom.z[particle] = 0.0 + (double)zdir*a;
               ch = '0';
               particle++;
 
@@ -121,44 +121,30 @@ int initialize_positions(char* fn_c, char* fn_i )
   {
 
     /* ============================================ */
-    /*  Check to see if the file exists and open it */
-    /*  if it does                                  */
+    /*  Read the coordinates from the file          */
     /* ============================================ */
-    if (!(fp = fopen(fn_c, "r")))
-    {
-      fprintf(stdout, "Coordinate file \"%s\" does not exist.\n", fn_c);
-      return(ERROR_FILE_NOT_FOUND);
-    }
-    unsigned long N = 0; //counter for number of atoms 
+    return_flag = read_vectors(fn_c, atom.x, atom.y, atom.z, sim.N, &N, &bad);
+    if (return_flag == ERROR_FILE_NOT_FOUND) fprintf(stdout, "Coordinate file \"%s\" does not exist.\n", fn_c);
+    if (return_flag) return(return_flag);
 
     /* ============================================ */
-    /*  Read the coordinates from the file          */
+    /*  Check to see if any of the input            */
+    /*  coordinates are outside of the box.  The    */
+    /*  first problem in the file is reported.      */
     /* ============================================ */
-    for (i = 0; i<sim.N; i++)
+    for (i = 0; i < bad; i++)
     {
-      read_flag = readline(buff, MAX_LINE, fp);
-      if (!read_flag) break;
-
-      if (sscanf(buff, "%lf %lf %lf", &atom[i].x, &atom[i].y, &atom[i].z) != 3)//if statement checks to see if three numbers are read
+      if (atom.x[i] > sim.length || atom.y[i] > sim.length || atom.z[i] > sim.length)
       {
-        fprintf(stdout, "There is a problem with the coordinates for atom %lu in \"%s\"\n", i+1, fn_c);
+        fprintf(stdout, "The coordinates (%lf, %lf, %lf) for atom %lu read in from coordinate file \"%s\" is outside of the box of length %lf\n", atom.x[i], atom.y[i], atom.z[i], i, fn_c, sim.length);
         return(ERROR_INPUT_FILE);
       }
-      else
-      {
-        N++;
-        /* ============================================ */
-        /*  Check to see if any of the input            */
-        /*  coordinates are outside of the box.         */
-        /* ============================================ */
-        if (atom[i].x > sim.length || atom[i].y > sim.length || atom[i].z > sim.length)
-        {
-          fprintf(stdout, "The coordinates (%lf, %lf, %lf) for atom %lu read in from coordinate file \"%s\" is outside of the box of length %lf\n", atom[i].x, atom[i].y, atom[i].z, i, fn_c, sim.length);
-          return(ERROR_INPUT_FILE);
-        }
-      }
     }
-    fclose(fp);   
+    if (bad < N)
+    {
+      fprintf(stdout, "There is a problem with the coordinates for atom %lu in \"%s\"\n", bad+1, fn_c);
+      return(ERROR_INPUT_FILE);
+    }
 
     /* ============================================ */
     /*  Check to see if the number of coordinates   */
@@ -21,12 +21,13 @@
 /* If the user specifies a velocity file in the input file, the             */
 /* velocities are read in.  Otherwise, they are generated from a random     */
 /* gaussian distribution.  The rand approach is the default behavior.       */
+/* The file is read by read_vectors() and may be text or binary.            */
 /* ======================================================================== */
 
 #include "includes.h"
 
-bool readline(char*, int, FILE*);
-double ran_num_double(long, double, double);
+int read_vectors(const char*, double*, double*, double*, unsigned long, unsigned long*, unsigned long*);
+void ran_stream_fill(struct ran_stream*, double*, unsigned long, double, double);
 double kinetic_energy(void);
 double temperature(double);
 double scale_velocities(double);
@@ -36,10 +37,7 @@ int error_exit(int);
 
 int initialize_velocities(char* fn_c, char* fn_i )
 {
-  char buff[MAX_LINE];
-  unsigned long i;
-  FILE *fp;
-  bool read_flag;
+  unsigned long N, bad; //number of velocities read, first bad line
   double vmax = sqrt(sim.T*3.0);
   double ke, temp;
   int return_flag;
@@ -50,12 +48,9 @@ int initialize_velocities(char* fn_c, char* fn_i )
   /* ------------------------------------------------------------------- */
   if (!strcmp(fn_c, "generate")) 
   {
-    for (i = 0; i<sim.N; i++)
-    {
-      atom[i].vx = ran_num_double(1, -1, 1)*vmax;
-      atom[i].vy = ran_num_double(1, -1, 1)*vmax;
-      atom[i].vz = ran_num_double(1, -1, 1)*vmax;
-    }
+    ran_stream_fill(&ran, atom.vx, sim.N, -vmax, vmax);
+    ran_stream_fill(&ran, atom.vy, sim.N, -vmax, vmax);
+    ran_stream_fill(&ran, atom.vz, sim.N, -vmax, vmax);
 
     return_flag = zero_momentum();
     if (return_flag) error_exit(return_flag);
@@ -78,33 +73,18 @@ int initialize_velocities(char* fn_c, char* fn_i )
   else
   {
 
-    /* ============================================ */
-    /*  Check to see if the file exists and open it */
-    /*  if it does                                  */
-    /* ============================================ */
-    if (!(fp = fopen(fn_c, "r")))
-    {
-      fprintf(stdout, "Velocity file \"%s\" does not exist.\n", fn_c);
-      return(ERROR_FILE_NOT_FOUND);
-    }
-    unsigned long N = 0; //counter for number of velocities 
-
     /* ============================================ */
     /*  Read the velocities from the file           */
     /* ============================================ */
-    for (i = 0; i<sim.N; i++)
+    return_flag = read_vectors(fn_c, atom.vx, atom.vy, atom.vz, sim.N, &N, &bad);
+    if (return_flag == ERROR_FILE_NOT_FOUND) fprintf(stdout, "Velocity file \"%s\" does not exist.\n", fn_c);
+    if (return_flag) return(return_flag);
+    if (bad < N)
     {
-      read_flag = readline(buff, MAX_LINE, fp);
-      if (!read_flag) break;
-
-      if (sscanf(buff, "%lf %lf %lf", &atom[i].vx, &atom[i].vy, &atom[i].vz) != 3)//if statement checks to see if three numbers are read
-      {
-        fprintf(stdout, "There is a problem with the velocities for atom %lu in \"%s\"\n", i+1, fn_c);
-        return(ERROR_INPUT_FILE);
-      }
-      else N++;
+      fprintf(stdout, "There is a problem with the velocities for atom %lu in \"%s\"\n", bad+1, fn_c);
+      return(ERROR_INPUT_FILE);
     }
-   
+
     /* ============================================ */
     /*  Check to see if the number of velocities    */
     /*  in the file is equal to the number          */
@@ -116,8 +96,6 @@ int initialize_velocities(char* fn_c, char* fn_i )
       return(ERROR_INPUT_FILE);
     }
 
-    fclose(fp);
-    
     return(0);
   }
 }
\ No newline at end of file
@@ -33,7 +33,7 @@ double kinetic_energy(void)
 	unsigned long i;
 	for(i=0; i<sim.N; i++)
 	{
-		v2 = atom[i].vx*atom[i].vx + atom[i].vy*atom[i].vy + atom[i].vz*atom[i].vz;
+		v2 = atom.vx[i]*atom.vx[i] + atom.vy[i]*atom.vy[i] + atom.vz[i]*atom.vz[i];
 		ke += 0.5*v2;
 	}
 	return(ke);
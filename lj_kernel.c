@@ -0,0 +1,968 @@
+/* Copyright (C) 2017 Thomas Allen Knotts IV - All Rights Reserved          */
+/* This file is part of the program ljmcmd                                  */
+/*                                                                          */
+/* ljmcmd is free software: you can redistribute it and/or modify           */
+/* it under the terms of the GNU General Public License as published by     */
+/* the Free Software Foundation, either version 3 of the License, or        */
+/* (at your option) any later version.                                      */
+/*                                                                          */
+/* ljmcmd is distributed in the hope that it will be useful,                */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of           */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            */
+/* GNU General Public License for more details.                             */
+/*                                                                          */
+/* You should have received a copy of the GNU General Public License        */
+/* along with ljmcmd.  If not, see <http://www.gnu.org/licenses/>.          */
+
+/* ======================================================================== */
+/* lj_kernel.c                                                              */
+/*                                                                          */
+/* This file contains the Lennard Jones pair kernels used by forces() and   */
+/* atomic_pe().  Each kernel computes the interaction of one particle with  */
+/* a set of other particles given either as a contiguous range of indices   */
+/* or as a list of indices.  The minimum image convention is applied with   */
+/* rounding instead of branches and the cutoff is applied with masks, so    */
+/* the loops map onto SIMD registers.                                       */
+/*                                                                          */
+/* AVX2 and AVX-512 versions are compiled for x86-64 with gcc-compatible    */
+/* compilers and chosen at run time from the CPU features.  The scalar      */
+/* version is used otherwise.  The choice can be overridden by setting the  */
+/* environment variable LJMDMC_KERNEL to scalar, avx2, or avx512.           */
+/*                                                                          */
+/* The force kernels can also bin the pair distances in an rdf histogram,   */
+/* so that an rdf sample costs no extra pass over the pairs.                */
+/* ======================================================================== */
+
+#include "includes.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define LJ_X86
+#include <immintrin.h>
+#endif
+
+#define KERNEL_SCALAR 0
+#define KERNEL_AVX2   1
+#define KERNEL_AVX512 2
+
+static int kernel = KERNEL_SCALAR;
+
+/* ------------------------------------------------------------------- */
+/*  This function selects the kernel from the CPU features.            */
+/* ------------------------------------------------------------------- */
+void lj_kernel_select(void)
+{
+  char *env = getenv("LJMDMC_KERNEL");
+
+  kernel = KERNEL_SCALAR;
+#ifdef LJ_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) kernel = KERNEL_AVX512;
+  else if (__builtin_cpu_supports("avx2")) kernel = KERNEL_AVX2;
+
+  if (env != NULL)
+  {
+    if (!strcmp(env, "scalar")) kernel = KERNEL_SCALAR;
+    else if (!strcmp(env, "avx2") && __builtin_cpu_supports("avx2")) kernel = KERNEL_AVX2;
+    else if (!strcmp(env, "avx512") && __builtin_cpu_supports("avx512f")) kernel = KERNEL_AVX512;
+  }
+#else
+  (void)env;
+#endif
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function returns the name of the selected kernel              */
+/* ------------------------------------------------------------------- */
+const char* lj_kernel_name(void)
+{
+  if (kernel == KERNEL_AVX512) return("avx512");
+  if (kernel == KERNEL_AVX2) return("avx2");
+  return("scalar");
+}
+
+/* ======================================================================== */
+/*  Scalar kernels                                                          */
+/* ======================================================================== */
+
+/* ------------------------------------------------------------------- */
+/*  This function bins a pair in the rdf histogram h by its squared    */
+/*  distance.  Distances beyond rdfmax are skipped by the histogram,   */
+/*  the same as in rdf_accumulate().                                   */
+/* ------------------------------------------------------------------- */
+static inline void rdf_bin(tak_histogram *h, double dr2)
+{
+  tak_histogram_increment_batch_squared(h, &dr2, 1);
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function computes the force between the particle at (xi, yi,  */
+/*  zi) and particle j.  The force on the particle is added to fi[],   */
+/*  the reaction is subtracted from the force on j, and the energy and */
+/*  virial are added to the accumulators.  If rdf is not NULL the pair */
+/*  is also binned in it.                                              */
+/* ------------------------------------------------------------------- */
+static inline void pair_force(double xi, double yi, double zi, unsigned long j,
+                              double *fx, double *fy, double *fz, double *fi, double *pe, double *virial, tak_histogram *rdf)
+{
+  double dr2, d2, d4, d8, d14;
+  double dx, dy, dz;
+  double fr;
+  double invL = 1.0 / sim.length;
+
+  dx = xi - atom.x[j];
+  dy = yi - atom.y[j];
+  dz = zi - atom.z[j];
+
+  /* ============================================ */
+  /*         Minimum Image Convention             */
+  /* ============================================ */
+  dx -= sim.length*floor(dx*invL + 0.5);
+  dy -= sim.length*floor(dy*invL + 0.5);
+  dz -= sim.length*floor(dz*invL + 0.5);
+
+  dr2 = dx*dx + dy*dy + dz*dz;
+  if (rdf != NULL) rdf_bin(rdf, dr2);
+
+  /* ============================================ */
+  /*         Distance and Energy Calculation      */
+  /* ============================================ */
+  if (dr2 < sim.rc2)
+  {
+    d2 = 1.0 / dr2;
+    d4 = d2*d2;
+    d8 = d4*d4;
+    d14 = d8*d4*d2;
+    fr = 48.0*(d14-0.5*d8);
+
+    fi[0] += fr*dx;
+    fi[1] += fr*dy;
+    fi[2] += fr*dz;
+    fx[j] -= fr*dx;
+    fy[j] -= fr*dy;
+    fz[j] -= fr*dz;
+
+    *virial += dr2*fr;
+    *pe += 4.0*(d14-d8)*dr2;
+  }
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function computes the energy and virial between the point     */
+/*  (x, y, z) and particle j.                                          */
+/* ------------------------------------------------------------------- */
+static inline double pair_energy(double x, double y, double z, unsigned long j, double *virial)
+{
+  double dr2, d2, d4, d8, d14;
+  double dx, dy, dz;
+  double fr;
+  double invL = 1.0 / sim.length;
+
+  dx = atom.x[j] - x;
+  dy = atom.y[j] - y;
+  dz = atom.z[j] - z;
+  dx -= sim.length*floor(dx*invL + 0.5);
+  dy -= sim.length*floor(dy*invL + 0.5);
+  dz -= sim.length*floor(dz*invL + 0.5);
+
+  dr2 = dx*dx + dy*dy + dz*dz;
+  if (dr2 < sim.rc2)
+  {
+    d2 = 1.0 / dr2;
+    d4 = d2*d2;
+    d8 = d4*d4;
+    d14 = d8*d4*d2;
+    fr = 48.0*(d14-0.5*d8);
+    *virial += dr2*fr;
+    return(4.0*(d14-d8)*dr2);
+  }
+  return(0.0);
+}
+
+static double force_range_scalar(unsigned long i, unsigned long j0, unsigned long j1,
+                                 double *fx, double *fy, double *fz, double *virial, tak_histogram *rdf)
+{
+  double fi[3] = {0.0, 0.0, 0.0};
+  double pe = 0.0;
+  unsigned long j;
+
+  for (j = j0; j < j1; j++) pair_force(atom.x[i], atom.y[i], atom.z[i], j, fx, fy, fz, fi, &pe, virial, rdf);
+  fx[i] += fi[0];
+  fy[i] += fi[1];
+  fz[i] += fi[2];
+  return(pe);
+}
+
+static double force_list_scalar(unsigned long i, const unsigned long *jl, unsigned long n,
+                                double *fx, double *fy, double *fz, double *virial, tak_histogram *rdf)
+{
+  double fi[3] = {0.0, 0.0, 0.0};
+  double pe = 0.0;
+  unsigned long k;
+
+  for (k = 0; k < n; k++) pair_force(atom.x[i], atom.y[i], atom.z[i], jl[k], fx, fy, fz, fi, &pe, virial, rdf);
+  fx[i] += fi[0];
+  fy[i] += fi[1];
+  fz[i] += fi[2];
+  return(pe);
+}
+
+static double energy_range_scalar(double x, double y, double z, unsigned long j0, unsigned long j1, double *virial)
+{
+  double u = 0.0;
+  unsigned long j;
+
+  for (j = j0; j < j1; j++) u += pair_energy(x, y, z, j, virial);
+  return(u);
+}
+
+static double delta_range_scalar(const double *ro, const double *rn, unsigned long j0, unsigned long j1, double *dvirial)
+{
+  double uold = 0.0, unew = 0.0;
+  double vold = 0.0, vnew = 0.0;
+  unsigned long j;
+
+  for (j = j0; j < j1; j++)
+  {
+    uold += pair_energy(ro[0], ro[1], ro[2], j, &vold);
+    unew += pair_energy(rn[0], rn[1], rn[2], j, &vnew);
+  }
+  *dvirial += vnew - vold;
+  return(unew - uold);
+}
+
+static double energy_list_scalar(double x, double y, double z, const unsigned long *jl, unsigned long n, double *virial)
+{
+  double u = 0.0;
+  unsigned long k;
+
+  for (k = 0; k < n; k++) u += pair_energy(x, y, z, jl[k], virial);
+  return(u);
+}
+
+static double delta_list_scalar(const double *ro, const double *rn, const unsigned long *jl, unsigned long n,
+                                double *du, double *uold, double *dvirial)
+{
+  double uo, un, unew = 0.0;
+  double vold = 0.0, vnew = 0.0;
+  unsigned long k;
+
+  for (k = 0; k < n; k++)
+  {
+    uo = pair_energy(ro[0], ro[1], ro[2], jl[k], &vold);
+    un = pair_energy(rn[0], rn[1], rn[2], jl[k], &vnew);
+    du[k] = un - uo;
+    *uold += uo;
+    unew += un;
+  }
+  *dvirial += vnew - vold;
+  return(unew);
+}
+
+#ifdef LJ_X86
+/* ======================================================================== */
+/*  AVX2 kernels (4 pairs per iteration)                                    */
+/* ======================================================================== */
+
+__attribute__((target("avx2")))
+static inline double hsum_avx2(__m256d v)
+{
+  __m128d lo = _mm256_castpd256_pd128(v);
+  __m128d hi = _mm256_extractf128_pd(v, 1);
+  lo = _mm_add_pd(lo, hi);
+  return(_mm_cvtsd_f64(_mm_add_sd(lo, _mm_unpackhi_pd(lo, lo))));
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function computes the masked force factor, energy and virial  */
+/*  for four displacements.  It also applies the minimum image.        */
+/* ------------------------------------------------------------------- */
+__attribute__((target("avx2")))
+static inline __m256d force_factor_avx2(__m256d *dx, __m256d *dy, __m256d *dz, __m256d *pe, __m256d *vir)
+{
+  const __m256d L = _mm256_set1_pd(sim.length);
+  const __m256d invL = _mm256_set1_pd(1.0 / sim.length);
+  const __m256d rc2 = _mm256_set1_pd(sim.rc2);
+  const __m256d one = _mm256_set1_pd(1.0);
+  __m256d dr2, d2, d4, d8, d14, fr, mask;
+
+  *dx = _mm256_sub_pd(*dx, _mm256_mul_pd(L, _mm256_round_pd(_mm256_mul_pd(*dx, invL), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC)));
+  *dy = _mm256_sub_pd(*dy, _mm256_mul_pd(L, _mm256_round_pd(_mm256_mul_pd(*dy, invL), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC)));
+  *dz = _mm256_sub_pd(*dz, _mm256_mul_pd(L, _mm256_round_pd(_mm256_mul_pd(*dz, invL), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC)));
+  dr2 = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(*dx, *dx), _mm256_mul_pd(*dy, *dy)), _mm256_mul_pd(*dz, *dz));
+  mask = _mm256_cmp_pd(dr2, rc2, _CMP_LT_OQ);
+
+  d2 = _mm256_div_pd(one, dr2);
+  d4 = _mm256_mul_pd(d2, d2);
+  d8 = _mm256_mul_pd(d4, d4);
+  d14 = _mm256_mul_pd(_mm256_mul_pd(d8, d4), d2);
+  fr = _mm256_mul_pd(_mm256_set1_pd(48.0), _mm256_sub_pd(d14, _mm256_mul_pd(_mm256_set1_pd(0.5), d8)));
+  fr = _mm256_and_pd(mask, fr);
+
+  *vir = _mm256_add_pd(*vir, _mm256_mul_pd(dr2, fr));
+  *pe = _mm256_add_pd(*pe, _mm256_and_pd(mask, _mm256_mul_pd(_mm256_mul_pd(_mm256_set1_pd(4.0), _mm256_sub_pd(d14, d8)), dr2)));
+  return(fr);
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function bins four minimum image displacements in the rdf     */
+/* ------------------------------------------------------------------- */
+__attribute__((target("avx2")))
+static inline void rdf_bin_avx2(tak_histogram *h, __m256d dx, __m256d dy, __m256d dz)
+{
+  double dr2[4];
+
+  _mm256_storeu_pd(dr2, _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy)), _mm256_mul_pd(dz, dz)));
+  tak_histogram_increment_batch_squared(h, dr2, 4);
+}
+
+__attribute__((target("avx2")))
+static double force_range_avx2(unsigned long i, unsigned long j0, unsigned long j1,
+                               double *fx, double *fy, double *fz, double *virial, tak_histogram *rdf)
+{
+  __m256d xi = _mm256_set1_pd(atom.x[i]);
+  __m256d yi = _mm256_set1_pd(atom.y[i]);
+  __m256d zi = _mm256_set1_pd(atom.z[i]);
+  __m256d fxi = _mm256_setzero_pd(), fyi = _mm256_setzero_pd(), fzi = _mm256_setzero_pd();
+  __m256d pe = _mm256_setzero_pd(), vir = _mm256_setzero_pd();
+  __m256d dx, dy, dz, fr, t;
+  double fi[3] = {0.0, 0.0, 0.0};
+  double pes = 0.0, virs = 0.0;
+  unsigned long j;
+
+  for (j = j0; j + 4 <= j1; j += 4)
+  {
+    dx = _mm256_sub_pd(xi, _mm256_loadu_pd(&atom.x[j]));
+    dy = _mm256_sub_pd(yi, _mm256_loadu_pd(&atom.y[j]));
+    dz = _mm256_sub_pd(zi, _mm256_loadu_pd(&atom.z[j]));
+    fr = force_factor_avx2(&dx, &dy, &dz, &pe, &vir);
+    if (rdf != NULL) rdf_bin_avx2(rdf, dx, dy, dz);
+
+    t = _mm256_mul_pd(fr, dx);
+    fxi = _mm256_add_pd(fxi, t);
+    _mm256_storeu_pd(&fx[j], _mm256_sub_pd(_mm256_loadu_pd(&fx[j]), t));
+    t = _mm256_mul_pd(fr, dy);
+    fyi = _mm256_add_pd(fyi, t);
+    _mm256_storeu_pd(&fy[j], _mm256_sub_pd(_mm256_loadu_pd(&fy[j]), t));
+    t = _mm256_mul_pd(fr, dz);
+    fzi = _mm256_add_pd(fzi, t);
+    _mm256_storeu_pd(&fz[j], _mm256_sub_pd(_mm256_loadu_pd(&fz[j]), t));
+  }
+  for (; j < j1; j++) pair_force(atom.x[i], atom.y[i], atom.z[i], j, fx, fy, fz, fi, &pes, &virs, rdf);
+
+  fx[i] += hsum_avx2(fxi) + fi[0];
+  fy[i] += hsum_avx2(fyi) + fi[1];
+  fz[i] += hsum_avx2(fzi) + fi[2];
+  *virial += hsum_avx2(vir) + virs;
+  return(hsum_avx2(pe) + pes);
+}
+
+__attribute__((target("avx2")))
+static double force_list_avx2(unsigned long i, const unsigned long *jl, unsigned long n,
+                              double *fx, double *fy, double *fz, double *virial, tak_histogram *rdf)
+{
+  __m256d xi = _mm256_set1_pd(atom.x[i]);
+  __m256d yi = _mm256_set1_pd(atom.y[i]);
+  __m256d zi = _mm256_set1_pd(atom.z[i]);
+  __m256d fxi = _mm256_setzero_pd(), fyi = _mm256_setzero_pd(), fzi = _mm256_setzero_pd();
+  __m256d pe = _mm256_setzero_pd(), vir = _mm256_setzero_pd();
+  __m256d dx, dy, dz, fr;
+  __m256i idx;
+  double tx[4], ty[4], tz[4];
+  double fi[3] = {0.0, 0.0, 0.0};
+  double pes = 0.0, virs = 0.0;
+  unsigned long k;
+  int l;
+
+  for (k = 0; k + 4 <= n; k += 4)
+  {
+    idx = _mm256_loadu_si256((const __m256i*)&jl[k]);
+    dx = _mm256_sub_pd(xi, _mm256_i64gather_pd(atom.x, idx, 8));
+    dy = _mm256_sub_pd(yi, _mm256_i64gather_pd(atom.y, idx, 8));
+    dz = _mm256_sub_pd(zi, _mm256_i64gather_pd(atom.z, idx, 8));
+    fr = force_factor_avx2(&dx, &dy, &dz, &pe, &vir);
+    if (rdf != NULL) rdf_bin_avx2(rdf, dx, dy, dz);
+
+    dx = _mm256_mul_pd(fr, dx);
+    dy = _mm256_mul_pd(fr, dy);
+    dz = _mm256_mul_pd(fr, dz);
+    fxi = _mm256_add_pd(fxi, dx);
+    fyi = _mm256_add_pd(fyi, dy);
+    fzi = _mm256_add_pd(fzi, dz);
+
+    /* AVX2 has no scatter, so the reactions are applied one at a time */
+    _mm256_storeu_pd(tx, dx);
+    _mm256_storeu_pd(ty, dy);
+    _mm256_storeu_pd(tz, dz);
+    for (l = 0; l < 4; l++)
+    {
+      fx[jl[k+l]] -= tx[l];
+      fy[jl[k+l]] -= ty[l];
+      fz[jl[k+l]] -= tz[l];
+    }
+  }
+  for (; k < n; k++) pair_force(atom.x[i], atom.y[i], atom.z[i], jl[k], fx, fy, fz, fi, &pes, &virs, rdf);
+
+  fx[i] += hsum_avx2(fxi) + fi[0];
+  fy[i] += hsum_avx2(fyi) + fi[1];
+  fz[i] += hsum_avx2(fzi) + fi[2];
+  *virial += hsum_avx2(vir) + virs;
+  return(hsum_avx2(pe) + pes);
+}
+
+__attribute__((target("avx2")))
+static double energy_range_avx2(double x, double y, double z, unsigned long j0, unsigned long j1, double *virial)
+{
+  __m256d xv = _mm256_set1_pd(x);
+  __m256d yv = _mm256_set1_pd(y);
+  __m256d zv = _mm256_set1_pd(z);
+  __m256d u = _mm256_setzero_pd(), vir = _mm256_setzero_pd();
+  __m256d dx, dy, dz;
+  double us = 0.0, virs = 0.0;
+  unsigned long j;
+
+  for (j = j0; j + 4 <= j1; j += 4)
+  {
+    dx = _mm256_sub_pd(_mm256_loadu_pd(&atom.x[j]), xv);
+    dy = _mm256_sub_pd(_mm256_loadu_pd(&atom.y[j]), yv);
+    dz = _mm256_sub_pd(_mm256_loadu_pd(&atom.z[j]), zv);
+    force_factor_avx2(&dx, &dy, &dz, &u, &vir);
+  }
+  for (; j < j1; j++) us += pair_energy(x, y, z, j, &virs);
+
+  *virial += hsum_avx2(vir) + virs;
+  return(hsum_avx2(u) + us);
+}
+
+__attribute__((target("avx2")))
+static double delta_range_avx2(const double *ro, const double *rn, unsigned long j0, unsigned long j1, double *dvirial)
+{
+  __m256d xo = _mm256_set1_pd(ro[0]), yo = _mm256_set1_pd(ro[1]), zo = _mm256_set1_pd(ro[2]);
+  __m256d xn = _mm256_set1_pd(rn[0]), yn = _mm256_set1_pd(rn[1]), zn = _mm256_set1_pd(rn[2]);
+  __m256d uold = _mm256_setzero_pd(), unew = _mm256_setzero_pd();
+  __m256d vold = _mm256_setzero_pd(), vnew = _mm256_setzero_pd();
+  __m256d xj, yj, zj, dx, dy, dz;
+  double uolds = 0.0, unews = 0.0, volds = 0.0, vnews = 0.0;
+  unsigned long j;
+
+  for (j = j0; j + 4 <= j1; j += 4)
+  {
+    xj = _mm256_loadu_pd(&atom.x[j]);
+    yj = _mm256_loadu_pd(&atom.y[j]);
+    zj = _mm256_loadu_pd(&atom.z[j]);
+
+    dx = _mm256_sub_pd(xj, xo);
+    dy = _mm256_sub_pd(yj, yo);
+    dz = _mm256_sub_pd(zj, zo);
+    force_factor_avx2(&dx, &dy, &dz, &uold, &vold);
+
+    dx = _mm256_sub_pd(xj, xn);
+    dy = _mm256_sub_pd(yj, yn);
+    dz = _mm256_sub_pd(zj, zn);
+    force_factor_avx2(&dx, &dy, &dz, &unew, &vnew);
+  }
+  for (; j < j1; j++)
+  {
+    uolds += pair_energy(ro[0], ro[1], ro[2], j, &volds);
+    unews += pair_energy(rn[0], rn[1], rn[2], j, &vnews);
+  }
+
+  *dvirial += (hsum_avx2(vnew) + vnews) - (hsum_avx2(vold) + volds);
+  return((hsum_avx2(unew) + unews) - (hsum_avx2(uold) + uolds));
+}
+
+__attribute__((target("avx2")))
+static double energy_list_avx2(double x, double y, double z, const unsigned long *jl, unsigned long n, double *virial)
+{
+  __m256d xv = _mm256_set1_pd(x);
+  __m256d yv = _mm256_set1_pd(y);
+  __m256d zv = _mm256_set1_pd(z);
+  __m256d u = _mm256_setzero_pd(), vir = _mm256_setzero_pd();
+  __m256d dx, dy, dz;
+  __m256i idx;
+  double us = 0.0, virs = 0.0;
+  unsigned long k;
+
+  for (k = 0; k + 4 <= n; k += 4)
+  {
+    idx = _mm256_loadu_si256((const __m256i*)&jl[k]);
+    dx = _mm256_sub_pd(_mm256_i64gather_pd(atom.x, idx, 8), xv);
+    dy = _mm256_sub_pd(_mm256_i64gather_pd(atom.y, idx, 8), yv);
+    dz = _mm256_sub_pd(_mm256_i64gather_pd(atom.z, idx, 8), zv);
+    force_factor_avx2(&dx, &dy, &dz, &u, &vir);
+  }
+  for (; k < n; k++) us += pair_energy(x, y, z, jl[k], &virs);
+
+  *virial += hsum_avx2(vir) + virs;
+  return(hsum_avx2(u) + us);
+}
+
+__attribute__((target("avx2")))
+static double delta_list_avx2(const double *ro, const double *rn, const unsigned long *jl, unsigned long n,
+                              double *du, double *uold, double *dvirial)
+{
+  __m256d xo = _mm256_set1_pd(ro[0]), yo = _mm256_set1_pd(ro[1]), zo = _mm256_set1_pd(ro[2]);
+  __m256d xn = _mm256_set1_pd(rn[0]), yn = _mm256_set1_pd(rn[1]), zn = _mm256_set1_pd(rn[2]);
+  __m256d uo, un, uolds = _mm256_setzero_pd(), unews = _mm256_setzero_pd();
+  __m256d vold = _mm256_setzero_pd(), vnew = _mm256_setzero_pd();
+  __m256d xj, yj, zj, dx, dy, dz, vt, tail;
+  __m256i idx;
+  unsigned long k, tj[4];
+  int l;
+
+  for (k = 0; k + 4 <= n; k += 4)
+  {
+    idx = _mm256_loadu_si256((const __m256i*)&jl[k]);
+    xj = _mm256_i64gather_pd(atom.x, idx, 8);
+    yj = _mm256_i64gather_pd(atom.y, idx, 8);
+    zj = _mm256_i64gather_pd(atom.z, idx, 8);
+
+    dx = _mm256_sub_pd(xj, xo);
+    dy = _mm256_sub_pd(yj, yo);
+    dz = _mm256_sub_pd(zj, zo);
+    uo = _mm256_setzero_pd();
+    force_factor_avx2(&dx, &dy, &dz, &uo, &vold);
+
+    dx = _mm256_sub_pd(xj, xn);
+    dy = _mm256_sub_pd(yj, yn);
+    dz = _mm256_sub_pd(zj, zn);
+    un = _mm256_setzero_pd();
+    force_factor_avx2(&dx, &dy, &dz, &un, &vnew);
+
+    _mm256_storeu_pd(&du[k], _mm256_sub_pd(un, uo));
+    uolds = _mm256_add_pd(uolds, uo);
+    unews = _mm256_add_pd(unews, un);
+  }
+
+  /* ============================================ */
+  /*  The last n%4 pairs as one masked vector.    */
+  /*  The unused lanes repeat the last index and  */
+  /*  are cleared from the results.               */
+  /* ============================================ */
+  if (k < n)
+  {
+    for (l = 0; l < 4; l++) tj[l] = jl[k + l < n ? k + l : n - 1];
+    tail = _mm256_castsi256_pd(_mm256_cmpgt_epi64(_mm256_set1_epi64x((long long)(n - k)), _mm256_set_epi64x(3, 2, 1, 0)));
+    idx = _mm256_loadu_si256((const __m256i*)tj);
+    xj = _mm256_i64gather_pd(atom.x, idx, 8);
+    yj = _mm256_i64gather_pd(atom.y, idx, 8);
+    zj = _mm256_i64gather_pd(atom.z, idx, 8);
+
+    dx = _mm256_sub_pd(xj, xo);
+    dy = _mm256_sub_pd(yj, yo);
+    dz = _mm256_sub_pd(zj, zo);
+    uo = _mm256_setzero_pd();
+    vt = _mm256_setzero_pd();
+    force_factor_avx2(&dx, &dy, &dz, &uo, &vt);
+    uo = _mm256_and_pd(tail, uo);
+    vold = _mm256_add_pd(vold, _mm256_and_pd(tail, vt));
+
+    dx = _mm256_sub_pd(xj, xn);
+    dy = _mm256_sub_pd(yj, yn);
+    dz = _mm256_sub_pd(zj, zn);
+    un = _mm256_setzero_pd();
+    vt = _mm256_setzero_pd();
+    force_factor_avx2(&dx, &dy, &dz, &un, &vt);
+    un = _mm256_and_pd(tail, un);
+    vnew = _mm256_add_pd(vnew, _mm256_and_pd(tail, vt));
+
+    _mm256_maskstore_pd(&du[k], _mm256_castpd_si256(tail), _mm256_sub_pd(un, uo));
+    uolds = _mm256_add_pd(uolds, uo);
+    unews = _mm256_add_pd(unews, un);
+  }
+
+  *uold += hsum_avx2(uolds);
+  *dvirial += hsum_avx2(vnew) - hsum_avx2(vold);
+  return(hsum_avx2(unews));
+}
+
+/* ======================================================================== */
+/*  AVX-512 kernels (8 pairs per iteration)                                 */
+/* ======================================================================== */
+
+/* ------------------------------------------------------------------- */
+/*  This function computes the masked force factor, energy and virial  */
+/*  for eight displacements.  It also applies the minimum image.       */
+/* ------------------------------------------------------------------- */
+__attribute__((target("avx512f")))
+static inline __m512d force_factor_avx512(__m512d *dx, __m512d *dy, __m512d *dz, __m512d *pe, __m512d *vir)
+{
+  const __m512d L = _mm512_set1_pd(sim.length);
+  const __m512d invL = _mm512_set1_pd(1.0 / sim.length);
+  const __m512d rc2 = _mm512_set1_pd(sim.rc2);
+  const __m512d one = _mm512_set1_pd(1.0);
+  __m512d dr2, d2, d4, d8, d14, fr;
+  __mmask8 mask;
+
+  *dx = _mm512_sub_pd(*dx, _mm512_mul_pd(L, _mm512_roundscale_pd(_mm512_mul_pd(*dx, invL), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC)));
+  *dy = _mm512_sub_pd(*dy, _mm512_mul_pd(L, _mm512_roundscale_pd(_mm512_mul_pd(*dy, invL), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC)));
+  *dz = _mm512_sub_pd(*dz, _mm512_mul_pd(L, _mm512_roundscale_pd(_mm512_mul_pd(*dz, invL), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC)));
+  dr2 = _mm512_add_pd(_mm512_add_pd(_mm512_mul_pd(*dx, *dx), _mm512_mul_pd(*dy, *dy)), _mm512_mul_pd(*dz, *dz));
+  mask = _mm512_cmp_pd_mask(dr2, rc2, _CMP_LT_OQ);
+
+  d2 = _mm512_div_pd(one, dr2);
+  d4 = _mm512_mul_pd(d2, d2);
+  d8 = _mm512_mul_pd(d4, d4);
+  d14 = _mm512_mul_pd(_mm512_mul_pd(d8, d4), d2);
+  fr = _mm512_maskz_mul_pd(mask, _mm512_set1_pd(48.0), _mm512_sub_pd(d14, _mm512_mul_pd(_mm512_set1_pd(0.5), d8)));
+
+  *vir = _mm512_add_pd(*vir, _mm512_mul_pd(dr2, fr));
+  *pe = _mm512_mask_add_pd(*pe, mask, *pe, _mm512_mul_pd(_mm512_mul_pd(_mm512_set1_pd(4.0), _mm512_sub_pd(d14, d8)), dr2));
+  return(fr);
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function bins eight minimum image displacements in the rdf    */
+/* ------------------------------------------------------------------- */
+__attribute__((target("avx512f")))
+static inline void rdf_bin_avx512(tak_histogram *h, __m512d dx, __m512d dy, __m512d dz)
+{
+  double dr2[8];
+
+  _mm512_storeu_pd(dr2, _mm512_add_pd(_mm512_add_pd(_mm512_mul_pd(dx, dx), _mm512_mul_pd(dy, dy)), _mm512_mul_pd(dz, dz)));
+  tak_histogram_increment_batch_squared(h, dr2, 8);
+}
+
+__attribute__((target("avx512f")))
+static double force_range_avx512(unsigned long i, unsigned long j0, unsigned long j1,
+                                 double *fx, double *fy, double *fz, double *virial, tak_histogram *rdf)
+{
+  __m512d xi = _mm512_set1_pd(atom.x[i]);
+  __m512d yi = _mm512_set1_pd(atom.y[i]);
+  __m512d zi = _mm512_set1_pd(atom.z[i]);
+  __m512d fxi = _mm512_setzero_pd(), fyi = _mm512_setzero_pd(), fzi = _mm512_setzero_pd();
+  __m512d pe = _mm512_setzero_pd(), vir = _mm512_setzero_pd();
+  __m512d dx, dy, dz, fr, t;
+  double fi[3] = {0.0, 0.0, 0.0};
+  double pes = 0.0, virs = 0.0;
+  unsigned long j;
+
+  for (j = j0; j + 8 <= j1; j += 8)
+  {
+    dx = _mm512_sub_pd(xi, _mm512_loadu_pd(&atom.x[j]));
+    dy = _mm512_sub_pd(yi, _mm512_loadu_pd(&atom.y[j]));
+    dz = _mm512_sub_pd(zi, _mm512_loadu_pd(&atom.z[j]));
+    fr = force_factor_avx512(&dx, &dy, &dz, &pe, &vir);
+    if (rdf != NULL) rdf_bin_avx512(rdf, dx, dy, dz);
+
+    t = _mm512_mul_pd(fr, dx);
+    fxi = _mm512_add_pd(fxi, t);
+    _mm512_storeu_pd(&fx[j], _mm512_sub_pd(_mm512_loadu_pd(&fx[j]), t));
+    t = _mm512_mul_pd(fr, dy);
+    fyi = _mm512_add_pd(fyi, t);
+    _mm512_storeu_pd(&fy[j], _mm512_sub_pd(_mm512_loadu_pd(&fy[j]), t));
+    t = _mm512_mul_pd(fr, dz);
+    fzi = _mm512_add_pd(fzi, t);
+    _mm512_storeu_pd(&fz[j], _mm512_sub_pd(_mm512_loadu_pd(&fz[j]), t));
+  }
+  for (; j < j1; j++) pair_force(atom.x[i], atom.y[i], atom.z[i], j, fx, fy, fz, fi, &pes, &virs, rdf);
+
+  fx[i] += _mm512_reduce_add_pd(fxi) + fi[0];
+  fy[i] += _mm512_reduce_add_pd(fyi) + fi[1];
+  fz[i] += _mm512_reduce_add_pd(fzi) + fi[2];
+  *virial += _mm512_reduce_add_pd(vir) + virs;
+  return(_mm512_reduce_add_pd(pe) + pes);
+}
+
+__attribute__((target("avx512f")))
+static double force_list_avx512(unsigned long i, const unsigned long *jl, unsigned long n,
+                                double *fx, double *fy, double *fz, double *virial, tak_histogram *rdf)
+{
+  __m512d xi = _mm512_set1_pd(atom.x[i]);
+  __m512d yi = _mm512_set1_pd(atom.y[i]);
+  __m512d zi = _mm512_set1_pd(atom.z[i]);
+  __m512d fxi = _mm512_setzero_pd(), fyi = _mm512_setzero_pd(), fzi = _mm512_setzero_pd();
+  __m512d pe = _mm512_setzero_pd(), vir = _mm512_setzero_pd();
+  __m512d dx, dy, dz, fr, t;
+  __m512i idx;
+  double fi[3] = {0.0, 0.0, 0.0};
+  double pes = 0.0, virs = 0.0;
+  unsigned long k;
+
+  /* the indices in a list are distinct, so the scatters do not collide */
+  for (k = 0; k + 8 <= n; k += 8)
+  {
+    idx = _mm512_loadu_si512((const void*)&jl[k]);
+    dx = _mm512_sub_pd(xi, _mm512_i64gather_pd(idx, atom.x, 8));
+    dy = _mm512_sub_pd(yi, _mm512_i64gather_pd(idx, atom.y, 8));
+    dz = _mm512_sub_pd(zi, _mm512_i64gather_pd(idx, atom.z, 8));
+    fr = force_factor_avx512(&dx, &dy, &dz, &pe, &vir);
+    if (rdf != NULL) rdf_bin_avx512(rdf, dx, dy, dz);
+
+    t = _mm512_mul_pd(fr, dx);
+    fxi = _mm512_add_pd(fxi, t);
+    _mm512_i64scatter_pd(fx, idx, _mm512_sub_pd(_mm512_i64gather_pd(idx, fx, 8), t), 8);
+    t = _mm512_mul_pd(fr, dy);
+    fyi = _mm512_add_pd(fyi, t);
+    _mm512_i64scatter_pd(fy, idx, _mm512_sub_pd(_mm512_i64gather_pd(idx, fy, 8), t), 8);
+    t = _mm512_mul_pd(fr, dz);
+    fzi = _mm512_add_pd(fzi, t);
+    _mm512_i64scatter_pd(fz, idx, _mm512_sub_pd(_mm512_i64gather_pd(idx, fz, 8), t), 8);
+  }
+  for (; k < n; k++) pair_force(atom.x[i], atom.y[i], atom.z[i], jl[k], fx, fy, fz, fi, &pes, &virs, rdf);
+
+  fx[i] += _mm512_reduce_add_pd(fxi) + fi[0];
+  fy[i] += _mm512_reduce_add_pd(fyi) + fi[1];
+  fz[i] += _mm512_reduce_add_pd(fzi) + fi[2];
+  *virial += _mm512_reduce_add_pd(vir) + virs;
+  return(_mm512_reduce_add_pd(pe) + pes);
+}
+
+__attribute__((target("avx512f")))
+static double energy_range_avx512(double x, double y, double z, unsigned long j0, unsigned long j1, double *virial)
+{
+  __m512d xv = _mm512_set1_pd(x);
+  __m512d yv = _mm512_set1_pd(y);
+  __m512d zv = _mm512_set1_pd(z);
+  __m512d u = _mm512_setzero_pd(), vir = _mm512_setzero_pd();
+  __m512d dx, dy, dz;
+  double us = 0.0, virs = 0.0;
+  unsigned long j;
+
+  for (j = j0; j + 8 <= j1; j += 8)
+  {
+    dx = _mm512_sub_pd(_mm512_loadu_pd(&atom.x[j]), xv);
+    dy = _mm512_sub_pd(_mm512_loadu_pd(&atom.y[j]), yv);
+    dz = _mm512_sub_pd(_mm512_loadu_pd(&atom.z[j]), zv);
+    force_factor_avx512(&dx, &dy, &dz, &u, &vir);
+  }
+  for (; j < j1; j++) us += pair_energy(x, y, z, j, &virs);
+
+  *virial += _mm512_reduce_add_pd(vir) + virs;
+  return(_mm512_reduce_add_pd(u) + us);
+}
+
+__attribute__((target("avx512f")))
+static double delta_range_avx512(const double *ro, const double *rn, unsigned long j0, unsigned long j1, double *dvirial)
+{
+  __m512d xo = _mm512_set1_pd(ro[0]), yo = _mm512_set1_pd(ro[1]), zo = _mm512_set1_pd(ro[2]);
+  __m512d xn = _mm512_set1_pd(rn[0]), yn = _mm512_set1_pd(rn[1]), zn = _mm512_set1_pd(rn[2]);
+  __m512d uold = _mm512_setzero_pd(), unew = _mm512_setzero_pd();
+  __m512d vold = _mm512_setzero_pd(), vnew = _mm512_setzero_pd();
+  __m512d xj, yj, zj, dx, dy, dz;
+  double uolds = 0.0, unews = 0.0, volds = 0.0, vnews = 0.0;
+  unsigned long j;
+
+  for (j = j0; j + 8 <= j1; j += 8)
+  {
+    xj = _mm512_loadu_pd(&atom.x[j]);
+    yj = _mm512_loadu_pd(&atom.y[j]);
+    zj = _mm512_loadu_pd(&atom.z[j]);
+
+    dx = _mm512_sub_pd(xj, xo);
+    dy = _mm512_sub_pd(yj, yo);
+    dz = _mm512_sub_pd(zj, zo);
+    force_factor_avx512(&dx, &dy, &dz, &uold, &vold);
+
+    dx = _mm512_sub_pd(xj, xn);
+    dy = _mm512_sub_pd(yj, yn);
+    dz = _mm512_sub_pd(zj, zn);
+    force_factor_avx512(&dx, &dy, &dz, &unew, &vnew);
+  }
+  for (; j < j1; j++)
+  {
+    uolds += pair_energy(ro[0], ro[1], ro[2], j, &volds);
+    unews += pair_energy(rn[0], rn[1], rn[2], j, &vnews);
+  }
+
+  *dvirial += (_mm512_reduce_add_pd(vnew) + vnews) - (_mm512_reduce_add_pd(vold) + volds);
+  return((_mm512_reduce_add_pd(unew) + unews) - (_mm512_reduce_add_pd(uold) + uolds));
+}
+
+__attribute__((target("avx512f")))
+static double energy_list_avx512(double x, double y, double z, const unsigned long *jl, unsigned long n, double *virial)
+{
+  __m512d xv = _mm512_set1_pd(x);
+  __m512d yv = _mm512_set1_pd(y);
+  __m512d zv = _mm512_set1_pd(z);
+  __m512d u = _mm512_setzero_pd(), vir = _mm512_setzero_pd();
+  __m512d dx, dy, dz;
+  __m512i idx;
+  double us = 0.0, virs = 0.0;
+  unsigned long k;
+
+  for (k = 0; k + 8 <= n; k += 8)
+  {
+    idx = _mm512_loadu_si512((const void*)&jl[k]);
+    dx = _mm512_sub_pd(_mm512_i64gather_pd(idx, atom.x, 8), xv);
+    dy = _mm512_sub_pd(_mm512_i64gather_pd(idx, atom.y, 8), yv);
+    dz = _mm512_sub_pd(_mm512_i64gather_pd(idx, atom.z, 8), zv);
+    force_factor_avx512(&dx, &dy, &dz, &u, &vir);
+  }
+  for (; k < n; k++) us += pair_energy(x, y, z, jl[k], &virs);
+
+  *virial += _mm512_reduce_add_pd(vir) + virs;
+  return(_mm512_reduce_add_pd(u) + us);
+}
+
+__attribute__((target("avx512f")))
+static double delta_list_avx512(const double *ro, const double *rn, const unsigned long *jl, unsigned long n,
+                                double *du, double *uold, double *dvirial)
+{
+  __m512d xo = _mm512_set1_pd(ro[0]), yo = _mm512_set1_pd(ro[1]), zo = _mm512_set1_pd(ro[2]);
+  __m512d xn = _mm512_set1_pd(rn[0]), yn = _mm512_set1_pd(rn[1]), zn = _mm512_set1_pd(rn[2]);
+  __m512d uo, un, uolds = _mm512_setzero_pd(), unews = _mm512_setzero_pd();
+  __m512d vold = _mm512_setzero_pd(), vnew = _mm512_setzero_pd();
+  __m512d xj, yj, zj, dx, dy, dz, vt;
+  __m512i idx;
+  __mmask8 tail;
+  unsigned long k;
+
+  for (k = 0; k + 8 <= n; k += 8)
+  {
+    idx = _mm512_loadu_si512((const void*)&jl[k]);
+    xj = _mm512_i64gather_pd(idx, atom.x, 8);
+    yj = _mm512_i64gather_pd(idx, atom.y, 8);
+    zj = _mm512_i64gather_pd(idx, atom.z, 8);
+
+    dx = _mm512_sub_pd(xj, xo);
+    dy = _mm512_sub_pd(yj, yo);
+    dz = _mm512_sub_pd(zj, zo);
+    uo = _mm512_setzero_pd();
+    force_factor_avx512(&dx, &dy, &dz, &uo, &vold);
+
+    dx = _mm512_sub_pd(xj, xn);
+    dy = _mm512_sub_pd(yj, yn);
+    dz = _mm512_sub_pd(zj, zn);
+    un = _mm512_setzero_pd();
+    force_factor_avx512(&dx, &dy, &dz, &un, &vnew);
+
+    _mm512_storeu_pd(&du[k], _mm512_sub_pd(un, uo));
+    uolds = _mm512_add_pd(uolds, uo);
+    unews = _mm512_add_pd(unews, un);
+  }
+
+  /* ============================================ */
+  /*  The last n%8 pairs as one masked vector.    */
+  /*  The unused lanes read no memory, since      */
+  /*  other threads may move any atom in a        */
+  /*  checkerboard sweep, and are cleared from    */
+  /*  the results.                                */
+  /* ============================================ */
+  if (k < n)
+  {
+    tail = (__mmask8)((1u << (n - k)) - 1u);
+    idx = _mm512_maskz_loadu_epi64(tail, (const void*)&jl[k]);
+    xj = _mm512_mask_i64gather_pd(_mm512_setzero_pd(), tail, idx, atom.x, 8);
+    yj = _mm512_mask_i64gather_pd(_mm512_setzero_pd(), tail, idx, atom.y, 8);
+    zj = _mm512_mask_i64gather_pd(_mm512_setzero_pd(), tail, idx, atom.z, 8);
+
+    dx = _mm512_sub_pd(xj, xo);
+    dy = _mm512_sub_pd(yj, yo);
+    dz = _mm512_sub_pd(zj, zo);
+    uo = _mm512_setzero_pd();
+    vt = _mm512_setzero_pd();
+    force_factor_avx512(&dx, &dy, &dz, &uo, &vt);
+    uo = _mm512_maskz_mov_pd(tail, uo);
+    vold = _mm512_mask_add_pd(vold, tail, vold, vt);
+
+    dx = _mm512_sub_pd(xj, xn);
+    dy = _mm512_sub_pd(yj, yn);
+    dz = _mm512_sub_pd(zj, zn);
+    un = _mm512_setzero_pd();
+    vt = _mm512_setzero_pd();
+    force_factor_avx512(&dx, &dy, &dz, &un, &vt);
+    un = _mm512_maskz_mov_pd(tail, un);
+    vnew = _mm512_mask_add_pd(vnew, tail, vnew, vt);
+
+    _mm512_mask_storeu_pd(&du[k], tail, _mm512_sub_pd(un, uo));
+    uolds = _mm512_add_pd(uolds, uo);
+    unews = _mm512_add_pd(unews, un);
+  }
+
+  *uold += _mm512_reduce_add_pd(uolds);
+  *dvirial += _mm512_reduce_add_pd(vnew) - _mm512_reduce_add_pd(vold);
+  return(_mm512_reduce_add_pd(unews));
+}
+#endif
+
+/* ======================================================================== */
+/*  Kernel entry points                                                     */
+/* ======================================================================== */
+
+/* ------------------------------------------------------------------- */
+/*  This function computes the forces between particle i and the       */
+/*  particles j0 to j1-1.  The forces are added to fx, fy, and fz, the */
+/*  virial is added to *virial, and the energy is returned.  If rdf is */
+/*  not NULL the pair distances are also binned in it.                 */
+/* ------------------------------------------------------------------- */
+double lj_force_range(unsigned long i, unsigned long j0, unsigned long j1,
+                      double *fx, double *fy, double *fz, double *virial, tak_histogram *rdf)
+{
+#ifdef LJ_X86
+  if (kernel == KERNEL_AVX512) return(force_range_avx512(i, j0, j1, fx, fy, fz, virial, rdf));
+  if (kernel == KERNEL_AVX2) return(force_range_avx2(i, j0, j1, fx, fy, fz, virial, rdf));
+#endif
+  return(force_range_scalar(i, j0, j1, fx, fy, fz, virial, rdf));
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function is the same as lj_force_range() except that the      */
+/*  particles j are given by the n distinct indices in jl.             */
+/* ------------------------------------------------------------------- */
+double lj_force_list(unsigned long i, const unsigned long *jl, unsigned long n,
+                     double *fx, double *fy, double *fz, double *virial, tak_histogram *rdf)
+{
+#ifdef LJ_X86
+  if (kernel == KERNEL_AVX512) return(force_list_avx512(i, jl, n, fx, fy, fz, virial, rdf));
+  if (kernel == KERNEL_AVX2) return(force_list_avx2(i, jl, n, fx, fy, fz, virial, rdf));
+#endif
+  return(force_list_scalar(i, jl, n, fx, fy, fz, virial, rdf));
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function returns the energy between the point (x, y, z) and   */
+/*  the particles j0 to j1-1.  The virial is added to *virial.         */
+/* ------------------------------------------------------------------- */
+double lj_energy_range(double x, double y, double z, unsigned long j0, unsigned long j1, double *virial)
+{
+#ifdef LJ_X86
+  if (kernel == KERNEL_AVX512) return(energy_range_avx512(x, y, z, j0, j1, virial));
+  if (kernel == KERNEL_AVX2) return(energy_range_avx2(x, y, z, j0, j1, virial));
+#endif
+  return(energy_range_scalar(x, y, z, j0, j1, virial));
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function returns the change in energy of the particles j0 to  */
+/*  j1-1 with a particle moved from ro to rn.  Each partner is loaded  */
+/*  once for both positions.  The change in virial is added to         */
+/*  *dvirial.                                                          */
+/* ------------------------------------------------------------------- */
+double lj_delta_range(const double *ro, const double *rn, unsigned long j0, unsigned long j1, double *dvirial)
+{
+#ifdef LJ_X86
+  if (kernel == KERNEL_AVX512) return(delta_range_avx512(ro, rn, j0, j1, dvirial));
+  if (kernel == KERNEL_AVX2) return(delta_range_avx2(ro, rn, j0, j1, dvirial));
+#endif
+  return(delta_range_scalar(ro, rn, j0, j1, dvirial));
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function is the same as lj_energy_range() except that the     */
+/*  particles j are given by the n indices in jl.                      */
+/* ------------------------------------------------------------------- */
+double lj_energy_list(double x, double y, double z, const unsigned long *jl, unsigned long n, double *virial)
+{
+#ifdef LJ_X86
+  if (kernel == KERNEL_AVX512) return(energy_list_avx512(x, y, z, jl, n, virial));
+  if (kernel == KERNEL_AVX2) return(energy_list_avx2(x, y, z, jl, n, virial));
+#endif
+  return(energy_list_scalar(x, y, z, jl, n, virial));
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function computes the pair energies of the n particles in jl  */
+/*  with a particle at ro and at rn in one pass.  The new energy is    */
+/*  returned, the old energy is added to *uold, the change of each     */
+/*  pair is stored in du[k], and the change in the virial is added to  */
+/*  *dvirial.                                                          */
+/* ------------------------------------------------------------------- */
+double lj_delta_list(const double *ro, const double *rn, const unsigned long *jl, unsigned long n,
+                     double *du, double *uold, double *dvirial)
+{
+#ifdef LJ_X86
+  if (kernel == KERNEL_AVX512) return(delta_list_avx512(ro, rn, jl, n, du, uold, dvirial));
+  if (kernel == KERNEL_AVX2) return(delta_list_avx2(ro, rn, jl, n, du, uold, dvirial));
+#endif
+  return(delta_list_scalar(ro, rn, jl, n, du, uold, dvirial));
+}
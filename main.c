@@ -42,25 +42,39 @@ int initialize_positions(char*, char*);
 int initialize_velocities(char*, char*);
 int initialize_files(char*);
 int initialize_counters(void);
+int cell_list_allocate(struct cell_struct*, double);
+int mc_cell_list_allocate(void);
+void mc_cell_list_build(void);
+void atomic_pe_all(void);
+int checkerboard_allocate(void);
+int neighbor_list_allocate(void);
+int rdf_allocate(void);
+void lj_kernel_select(void);
 int error_exit(int);
+int output_log_open(void);
+int async_io_start(void);
+int checkpoint_read(void);
+void checkpoint_signals_install(void);
+void output_log_printf(const char*, ...);
+void output_log_close(void);
 double ran_num_double(long, int, int);
 int nvemd(void);
 int nvtmc(void);
 double forces(void);
 double kinetic_energy(void);
 double temperature(double);
+double wall_clock(void);
+void timers_start(void);
 
 int main(int argc, char *argv[])
 {
-  FILE *fp;
   int return_flag;
-  time_t start_time, end_time;
   char input_errors[8192];
 
   /* ------------------------------------------------------------------- */
   /* Initialize the timer                                                */
   /* ------------------------------------------------------------------- */
-  start_time = time(NULL);
+  timers_start();
 
   /* ------------------------------------------------------------------- */
   /*  Check the argument                                                 */
@@ -79,6 +93,19 @@ int main(int argc, char *argv[])
   return_flag = read_input(argv[1], argv[2], input_errors);
   if (return_flag) error_exit(return_flag);
 
+  /* ------------------------------------------------------------------- */
+  /*  Start the walltime clock and catch the signals that stop the run   */
+  /* ------------------------------------------------------------------- */
+  checkpoint_signals_install();
+
+  /* ------------------------------------------------------------------- */
+  /*  Set the number of threads.  If the input file does not set it, the */
+  /*  OpenMP default (OMP_NUM_THREADS) is used.                          */
+  /* ------------------------------------------------------------------- */
+#ifdef _OPENMP
+  if (sim.threads > 0) omp_set_num_threads(sim.threads);
+#endif
+
   /* ------------------------------------------------------------------- */
   /*  Allocate memory to arrays                                          */
   /* ------------------------------------------------------------------- */
@@ -91,6 +118,53 @@ int main(int argc, char *argv[])
   return_flag = initialize_positions(sim.icoord, sim.inputfile);
   if (return_flag) error_exit(return_flag);
 
+  /* ------------------------------------------------------------------- */
+  /*  Select the pair kernel for this CPU                                */
+  /* ------------------------------------------------------------------- */
+  lj_kernel_select();
+
+  /* ------------------------------------------------------------------- */
+  /*  Set up the cell list for the force calculation.  In md the cells   */
+  /*  are used to build the neighbor list, so they must span the skin.   */
+  /* ------------------------------------------------------------------- */
+  if (!strcmp(sim.type, "md") && sim.skin > 0.0)
+  {
+    return_flag = cell_list_allocate(&cells, sim.rc + sim.skin);
+    if (return_flag) error_exit(return_flag);
+    return_flag = neighbor_list_allocate();
+    if (return_flag) error_exit(return_flag);
+  }
+  else
+  {
+    return_flag = cell_list_allocate(&cells, sim.rc);
+    if (return_flag) error_exit(return_flag);
+  }
+
+  /* ------------------------------------------------------------------- */
+  /*  Set up the cell list used to find the pairs binned in the rdf      */
+  /* ------------------------------------------------------------------- */
+  if (sim.rdf)
+  {
+    return_flag = rdf_allocate();
+    if (return_flag) error_exit(return_flag);
+  }
+
+  if (!strcmp(sim.type, "mc"))
+  {
+    return_flag = mc_cell_list_allocate();
+    if (return_flag) error_exit(return_flag);
+    if (mccells.grid.n >= 3)
+    {
+      mc_cell_list_build();
+      atomic_pe_all();
+    }
+    if (!strcmp(sim.sweep, "checkerboard"))
+    {
+      return_flag = checkerboard_allocate();
+      if (return_flag) error_exit(return_flag);
+    }
+  }
+
   /* ------------------------------------------------------------------- */
   /*  Initialize the random number generator                             */
   /* ------------------------------------------------------------------- */
@@ -115,6 +189,7 @@ int main(int argc, char *argv[])
   /*  iteration 0                                                        */
   /* ------------------------------------------------------------------- */
   iprop.pe = forces();
+  iprop.pe2 = iprop.pe * iprop.pe;
   if (!strcmp(sim.type, "md"))
   {
     iprop.ke = kinetic_energy();          //calculate the kinetic energy
@@ -126,10 +201,24 @@ int main(int argc, char *argv[])
   /* ------------------------------------------------------------------- */
   return_flag = initialize_counters();
 
+  /* ------------------------------------------------------------------- */
+  /*  Continue from a checkpoint if the input file asks for a restart    */
+  /* ------------------------------------------------------------------- */
+  if (ckpt.restart)
+  {
+    return_flag = checkpoint_read();
+    if (return_flag) error_exit(return_flag);
+  }
+
   /* ------------------------------------------------------------------- */
   /*  Initialize the output and movie files                              */
   /* ------------------------------------------------------------------- */
   return_flag = initialize_files(input_errors);
+  if (return_flag) error_exit(return_flag);
+  return_flag = output_log_open();
+  if (return_flag) error_exit(return_flag);
+  return_flag = async_io_start();
+  if (return_flag) error_exit(return_flag);
 
   /* ------------------------------------------------------------------- */
   /*  Call the driver for the md or mc simulation                        */
@@ -148,11 +237,9 @@ int main(int argc, char *argv[])
   /* ------------------------------------------------------------------- */
   /*  Calculate the wall time and finalize the simulation                */
   /* ------------------------------------------------------------------- */
-  end_time = time(NULL);
-  fprintf(stdout, "Total Wall Time: %f minutes.\n", difftime(end_time, start_time) / 60.0);
-  fp = fopen(sim.outputfile, "a");
-  fprintf(fp, "Total Wall Time: %f minutes\n", difftime(end_time, start_time) / 60.0);
-  fclose(fp);
+  fprintf(stdout, "Total Wall Time: %f minutes.\n", (wall_clock() - timers.start) / 60.0);
+  output_log_printf("Total Wall Time: %f minutes\n", (wall_clock() - timers.start) / 60.0);
+  output_log_close();
   //printf("Press enter to continue...\n");
   //getchar();
 
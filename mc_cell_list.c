@@ -0,0 +1,211 @@
+/* Copyright (C) 2017 Thomas Allen Knotts IV - All Rights Reserved          */
+/* This file is part of the program ljmcmd                                  */
+/*                                                                          */
+/* ljmcmd is free software: you can redistribute it and/or modify           */
+/* it under the terms of the GNU General Public License as published by     */
+/* the Free Software Foundation, either version 3 of the License, or        */
+/* (at your option) any later version.                                      */
+/*                                                                          */
+/* ljmcmd is distributed in the hope that it will be useful,                */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of           */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            */
+/* GNU General Public License for more details.                             */
+/*                                                                          */
+/* You should have received a copy of the GNU General Public License        */
+/* along with ljmcmd.  If not, see <http://www.gnu.org/licenses/>.          */
+
+
+/* ======================================================================== */
+/* mc_cell_list.c                                                           */
+/*                                                                          */
+/* This file contains the subroutines for the linked-cell list used in MC.  */
+/* The atoms of each cell are kept in a doubly linked list so that an       */
+/* accepted move only relinks the moved atom, which is O(1).  A trial move  */
+/* only needs the atoms in the 27 cells around the old and the new          */
+/* position, so the cost of a move does not grow with N.  The cells are     */
+/* gathered nearest first so that close contacts are found early.           */
+/* ======================================================================== */
+
+#include "includes.h"
+
+unsigned long cell_list_index(struct cell_struct*, double, double, double);
+unsigned long cell_list_neighbor(struct cell_struct*, unsigned long, int, int, int);
+
+/* ------------------------------------------------------------------- */
+/*  The 27 cells around a cell ordered by distance: the cell itself,   */
+/*  the 6 that share a face, the 12 that share an edge, and the 8 that */
+/*  share a corner.  Shell s ends at shell_end[s].                     */
+/* ------------------------------------------------------------------- */
+static const int shell_order[27][3] = {
+  { 0, 0, 0},
+  { 0, 0,-1}, { 0,-1, 0}, {-1, 0, 0}, { 1, 0, 0}, { 0, 1, 0}, { 0, 0, 1},
+  { 0,-1,-1}, {-1, 0,-1}, { 1, 0,-1}, { 0, 1,-1}, {-1,-1, 0}, { 1,-1, 0},
+  {-1, 1, 0}, { 1, 1, 0}, { 0,-1, 1}, {-1, 0, 1}, { 1, 0, 1}, { 0, 1, 1},
+  {-1,-1,-1}, { 1,-1,-1}, {-1, 1,-1}, { 1, 1,-1}, {-1,-1, 1}, { 1,-1, 1},
+  {-1, 1, 1}, { 1, 1, 1} };
+static const int shell_end[4] = {1, 7, 19, 27};
+
+/* ------------------------------------------------------------------- */
+/*  This function sets the number of cells for the cutoff and          */
+/*  allocates the lists.  If there are fewer than 3 cells per side     */
+/*  nothing is allocated and the MC moves use the all-pairs loops.     */
+/* ------------------------------------------------------------------- */
+int mc_cell_list_allocate(void)
+{
+  struct cell_struct *g = &mccells.grid;
+
+  mccells.head = NULL;
+  mccells.next = NULL;
+  mccells.prev = NULL;
+  mccells.cell = NULL;
+  mccells.jlist = NULL;
+  mccells.du = NULL;
+
+  g->n = (int)(sim.length / sim.rc);
+  g->start = NULL;
+  g->index = NULL;
+  g->cell = NULL;
+  if (g->n < 3) return(0);
+  g->ncells = g->n*g->n*g->n;
+  g->width = sim.length / (double)g->n;
+
+  mccells.head = (long*) calloc(g->ncells, sizeof(long));
+  mccells.next = (long*) calloc(sim.N, sizeof(long));
+  mccells.prev = (long*) calloc(sim.N, sizeof(long));
+  mccells.cell = (unsigned long*) calloc(sim.N, sizeof(unsigned long));
+  mccells.jlist = (unsigned long*) calloc(sim.N, sizeof(unsigned long));
+  mccells.du = (double*) calloc(sim.N, sizeof(double));
+  if (mccells.head == NULL || mccells.next == NULL || mccells.prev == NULL ||
+      mccells.cell == NULL || mccells.jlist == NULL || mccells.du == NULL)
+  {
+    fprintf(stdout, "ERROR: cannot allocate memory for the MC cell list\n");
+    return(11);
+  }
+  return(0);
+}
+
+/* ------------------------------------------------------------------- */
+/*  These functions remove atom i from its cell and add it to cell c   */
+/* ------------------------------------------------------------------- */
+static void unlink_atom(unsigned long i)
+{
+  if (mccells.prev[i] >= 0) mccells.next[mccells.prev[i]] = mccells.next[i];
+  else mccells.head[mccells.cell[i]] = mccells.next[i];
+  if (mccells.next[i] >= 0) mccells.prev[mccells.next[i]] = mccells.prev[i];
+}
+
+static void link_atom(unsigned long i, unsigned long c)
+{
+  mccells.cell[i] = c;
+  mccells.prev[i] = -1;
+  mccells.next[i] = mccells.head[c];
+  if (mccells.head[c] >= 0) mccells.prev[mccells.head[c]] = (long)i;
+  mccells.head[c] = (long)i;
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function places every atom in its cell.  It is called once    */
+/*  after the positions are read.                                      */
+/* ------------------------------------------------------------------- */
+void mc_cell_list_build(void)
+{
+  unsigned long i;
+  int k;
+
+  for (k = 0; k < mccells.grid.ncells; k++) mccells.head[k] = -1;
+  for (i = 0; i < sim.N; i++)
+    link_atom(i, cell_list_index(&mccells.grid, atom.x[i], atom.y[i], atom.z[i]));
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function moves atom i to the cell of its current position.    */
+/*  It is called after an accepted move.                               */
+/* ------------------------------------------------------------------- */
+void mc_cell_list_update(unsigned long i)
+{
+  unsigned long c = cell_list_index(&mccells.grid, atom.x[i], atom.y[i], atom.z[i]);
+
+  if (c == mccells.cell[i]) return;
+  unlink_atom(i);
+  link_atom(i, c);
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function returns nonzero if cells a and b are the same or     */
+/*  touching, counting the periodic images.                            */
+/* ------------------------------------------------------------------- */
+static int adjacent(unsigned long a, unsigned long b)
+{
+  int n = mccells.grid.n;
+  int d[3], k;
+
+  d[0] = abs((int)(a % n) - (int)(b % n));
+  d[1] = abs((int)((a / n) % n) - (int)((b / n) % n));
+  d[2] = abs((int)(a / n / n) - (int)(b / n / n));
+  for (k = 0; k < 3; k++)
+    if (d[k] > 1 && d[k] != n - 1) return(0);
+  return(1);
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function collects in jl every atom except atom i that is in   */
+/*  the 27 cells around cell cnew or the 27 cells around cell cold,    */
+/*  and returns how many there are.  The cells around cnew come first, */
+/*  nearest first, and if end is not NULL end[s] is set to the number  */
+/*  of atoms in shells 0 to s of them.                                 */
+/* ------------------------------------------------------------------- */
+unsigned long mc_cell_list_gather(unsigned long *jl, unsigned long i, unsigned long cnew, unsigned long cold,
+                                  unsigned long *end)
+{
+  struct cell_struct *g = &mccells.grid;
+  unsigned long c, n = 0;
+  long j;
+  int k, s;
+
+  /* ============================================ */
+  /*  Cells around the new position by shell      */
+  /* ============================================ */
+  for (s = 0, k = 0; s < 4; s++)
+  {
+    for (; k < shell_end[s]; k++)
+    {
+      c = cell_list_neighbor(g, cnew, shell_order[k][0], shell_order[k][1], shell_order[k][2]);
+      for (j = mccells.head[c]; j >= 0; j = mccells.next[j])
+        if ((unsigned long)j != i) jl[n++] = (unsigned long)j;
+    }
+    if (end != NULL) end[s] = n;
+  }
+  if (cnew == cold) return(n);
+
+  /* ============================================ */
+  /*  Cells around the old position that were not */
+  /*  already visited                             */
+  /* ============================================ */
+  for (k = 0; k < 27; k++)
+  {
+    c = cell_list_neighbor(g, cold, shell_order[k][0], shell_order[k][1], shell_order[k][2]);
+    if (adjacent(c, cnew)) continue;
+    for (j = mccells.head[c]; j >= 0; j = mccells.next[j])
+      if ((unsigned long)j != i) jl[n++] = (unsigned long)j;
+  }
+  return(n);
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function frees the memory of the MC cell list                 */
+/* ------------------------------------------------------------------- */
+void mc_cell_list_free(void)
+{
+  free(mccells.head);
+  free(mccells.next);
+  free(mccells.prev);
+  free(mccells.cell);
+  free(mccells.jlist);
+  free(mccells.du);
+  mccells.head = NULL;
+  mccells.next = NULL;
+  mccells.prev = NULL;
+  mccells.cell = NULL;
+  mccells.jlist = NULL;
+  mccells.du = NULL;
+}
@@ -36,9 +36,9 @@ int check_momentum(void)
 	vcumz = 0.0;
 	for (i = 0; i<sim.N; i++)
 	{
-		vcumx += atom[i].vx;
-		vcumy += atom[i].vy;
-		vcumz += atom[i].vz;
+		vcumx += atom.vx[i];
+		vcumy += atom.vy[i];
+		vcumz += atom.vz[i];
 	}
 	//printf("These numbers should be zero if linear momentum is zero.\n");
 	//printf("->%lf\n->%lf\n->%lf\n",vcumx,vcumy,vcumz);
@@ -65,9 +65,9 @@ int zero_momentum(void)
 	vcumz = 0.0;
 	for (i = 0; i<sim.N; i++)
 	{
-		vcumx += atom[i].vx;
-		vcumy += atom[i].vy;
-		vcumz += atom[i].vz;
+		vcumx += atom.vx[i];
+		vcumy += atom.vy[i];
+		vcumz += atom.vz[i];
 	}
 
 	vcumx = vcumx/(double)sim.N;
@@ -76,9 +76,9 @@ int zero_momentum(void)
 
 	for (i=0; i<sim.N; i++)
 	{
-		atom[i].vx -= vcumx;
-		atom[i].vy -= vcumy;
-		atom[i].vz -= vcumz;
+		atom.vx[i] -= vcumx;
+		atom.vy[i] -= vcumy;
+		atom.vz[i] -= vcumz;
 	}
   if (!check_momentum()) return 0;
   else return(1);
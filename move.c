@@ -20,7 +20,11 @@
 /* This function generates a random displacement on a random particle,      */
 /* calculates the new energy, and accepts or rejects the new position       */
 /* according to the Metropolis criterion.  It is the main propogation       */
-/* subroutine for an MC simulation.                                         */
+/* subroutine for an MC simulation.  When a move is accepted, the energy    */
+/* and virial in iprop are updated by the change in the particle's pair     */
+/* terms rather than by recomputing every pair.  The acceptance number is   */
+/* drawn before the energy is computed so that a trial can be rejected as   */
+/* soon as the partial new energy is known to be too high.                  */
 /* ======================================================================== */
 
 #include "includes.h"
@@ -28,13 +32,17 @@
 
 int    ran_num_int(double range1, double range2);
 double ran_num_double(long idum, double range1, double range2);
-double forces(void);
-double atomic_pe(unsigned long, double, double, double);
+double atomic_pe_delta(unsigned long, double, double, double, double*);
+bool   atomic_pe_trial(unsigned long, double, double, double, double, double*, double*);
+void   atomic_pe_accept(unsigned long);
+void   mc_cell_list_update(unsigned long);
 
 bool move(void)
 {
 	double xnew, ynew, znew;
-	double peold, penew, de;
+	double de, demax;
+	double dvir = 0.0;
+	bool accept;
     unsigned long particle;
 	
   /* ------------------------------------------------------------------- */
@@ -42,9 +50,9 @@ bool move(void)
   /* ------------------------------------------------------------------- */
 	iprop.ntrys += 1;
     particle = ran_num_int(0.0, (double)sim.N);
-	xnew = atom[particle].x + ran_num_double(1, -1, 1)*sim.dt;
-	ynew = atom[particle].y + ran_num_double(1, -1, 1)*sim.dt;
-	znew = atom[particle].z + ran_num_double(1, -1, 1)*sim.dt;
+	xnew = atom.x[particle] + ran_num_double(1, -1, 1)*sim.dt;
+	ynew = atom.y[particle] + ran_num_double(1, -1, 1)*sim.dt;
+	znew = atom.z[particle] + ran_num_double(1, -1, 1)*sim.dt;
 
   /* ------------------------------------------------------------------- */
   /*  Apply Periodic Boundary Conditions                                 */
@@ -65,23 +73,32 @@ bool move(void)
 		znew -= sim.length;
 
   /* ------------------------------------------------------------------- */
-  /*  Calculate the new and old energies                                 */
+  /*  Draw the acceptance number and convert it to the largest change    */
+  /*  in energy that is accepted: r < exp(-de/T) is de < -T ln(r)        */
   /* ------------------------------------------------------------------- */
-  peold = atomic_pe(particle, atom[particle].x, atom[particle].y, atom[particle].z);
-  penew = atomic_pe(particle, xnew, ynew, znew);
+  demax = -sim.T * log(ran_num_double(1, 0, 1));
 
   /* ------------------------------------------------------------------- */
 	/*  Accept/Reject the move                                             */
   /* ------------------------------------------------------------------- */
-  de = penew - peold;
-  if (ran_num_double(1, 0, 1) < (exp(-de / sim.T)))
+  if (mccells.grid.n >= 3) accept = atomic_pe_trial(particle, xnew, ynew, znew, demax, &de, &dvir);
+  else
   {
+    de = atomic_pe_delta(particle, xnew, ynew, znew, &dvir);
+    accept = (de < demax);
+  }
+
+  if (accept)
+  {
+    if (mccells.grid.n >= 3) atomic_pe_accept(particle);
     iprop.naccept += 1;
-    iprop.pe = forces();  //updates the force vectors and assigns new pe
+    iprop.pe += de;                   //only the pairs with the moved particle change
+    iprop.virial += dvir;
     iprop.pe2 = iprop.pe * iprop.pe;
-    atom[particle].x = xnew;
-    atom[particle].y = ynew;
-    atom[particle].z = znew;
+    atom.x[particle] = xnew;
+    atom.y[particle] = ynew;
+    atom.z[particle] = znew;
+    if (mccells.grid.n >= 3) mc_cell_list_update(particle);
     return(true);
   }
   else return(false);
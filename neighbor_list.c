@@ -0,0 +1,221 @@
+/* Copyright (C) 2017 Thomas Allen Knotts IV - All Rights Reserved          */
+/* This file is part of the program ljmcmd                                  */
+/*                                                                          */
+/* ljmcmd is free software: you can redistribute it and/or modify           */
+/* it under the terms of the GNU General Public License as published by     */
+/* the Free Software Foundation, either version 3 of the License, or        */
+/* (at your option) any later version.                                      */
+/*                                                                          */
+/* ljmcmd is distributed in the hope that it will be useful,                */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of           */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            */
+/* GNU General Public License for more details.                             */
+/*                                                                          */
+/* You should have received a copy of the GNU General Public License        */
+/* along with ljmcmd.  If not, see <http://www.gnu.org/licenses/>.          */
+
+/* ======================================================================== */
+/* neighbor_list.c                                                          */
+/*                                                                          */
+/* This file contains the subroutines for the Verlet neighbor list used in  */
+/* MD simulations.  The list holds every pair closer than rc+skin, so the   */
+/* forces can be found from the list alone until some atom has moved more   */
+/* than half the skin.  The displacements are taken from the diffusion      */
+/* accumulators dx, dy, and dz updated in verlet1().  See page 147 of       */
+/* Allen and Tildesley.                                                     */
+/* ======================================================================== */
+
+#include "includes.h"
+
+void          cell_list_build(struct cell_struct*);
+unsigned long cell_list_neighbor(struct cell_struct*, unsigned long, int, int, int);
+
+/* ------------------------------------------------------------------- */
+/*  This function allocates the neighbor list.  The initial size is an */
+/*  estimate from the density; the list grows if it is too small.      */
+/* ------------------------------------------------------------------- */
+int neighbor_list_allocate(void)
+{
+  double rl = sim.rc + sim.skin;
+
+  nlist.rl2 = rl*rl;
+  nlist.size = (unsigned long)(1.2 * 2.0 / 3.0 * PI * rl*rl*rl * sim.rho * (double)sim.N) + sim.N;
+  nlist.start = (unsigned long*) calloc(sim.N + 1, sizeof(unsigned long));
+  nlist.list = (unsigned long*) calloc(nlist.size, sizeof(unsigned long));
+  nlist.dx0 = (double*) calloc(sim.N, sizeof(double));
+  nlist.dy0 = (double*) calloc(sim.N, sizeof(double));
+  nlist.dz0 = (double*) calloc(sim.N, sizeof(double));
+  if (nlist.start == NULL || nlist.list == NULL || nlist.dx0 == NULL || nlist.dy0 == NULL || nlist.dz0 == NULL)
+  {
+    fprintf(stdout, "ERROR: cannot allocate memory for the neighbor list\n");
+    return(11);
+  }
+  nlist.rebuild = 1;
+  nlist.nbuild = 0;
+  nlist.npairs = 0.0;
+  return(0);
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function returns true if atoms i and j are within the list    */
+/*  radius.                                                            */
+/* ------------------------------------------------------------------- */
+static bool in_list_radius(unsigned long i, unsigned long j)
+{
+  double dx, dy, dz;
+
+  dx = atom.x[i] - atom.x[j];
+  dy = atom.y[i] - atom.y[j];
+  dz = atom.z[i] - atom.z[j];
+
+  /* ============================================ */
+  /*         Minimum Image Convention             */
+  /* ============================================ */
+  if (fabs(dx)>(sim.length*0.5))
+  {
+    if (dx < 0.0)
+      dx += sim.length;
+    else
+      dx -= sim.length;
+  }
+  if (fabs(dy)>(sim.length*0.5))
+  {
+    if (dy < 0.0)
+      dy += sim.length;
+    else
+      dy -= sim.length;
+  }
+  if (fabs(dz)>(sim.length*0.5))
+  {
+    if (dz < 0.0)
+      dz += sim.length;
+    else
+      dz -= sim.length;
+  }
+
+  return(dx*dx + dy*dy + dz*dz < nlist.rl2);
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function builds the list.  The cell list is used to find the  */
+/*  candidates when the box holds at least 3 cells per side.           */
+/* ------------------------------------------------------------------- */
+void neighbor_list_build(void)
+{
+  unsigned long i, j, b, c, cn, ncand;
+  unsigned long n = 0;
+  int dx, dy, dz;
+
+  if (cells.n >= 3) cell_list_build(&cells);
+
+  for (i = 0; i < sim.N; i++)
+  {
+    nlist.start[i] = n;
+
+    /* ============================================ */
+    /*  Make sure the list can hold every candidate */
+    /*  for this atom                               */
+    /* ============================================ */
+    ncand = sim.N;
+    if (cells.n >= 3)
+    {
+      ncand = 0;
+      c = cells.cell[i];
+      for (dz = -1; dz <= 1; dz++)
+        for (dy = -1; dy <= 1; dy++)
+          for (dx = -1; dx <= 1; dx++)
+          {
+            cn = cell_list_neighbor(&cells, c, dx, dy, dz);
+            ncand += cells.start[cn+1] - cells.start[cn];
+          }
+    }
+    if (n + ncand > nlist.size)
+    {
+      nlist.size = 2*nlist.size + ncand;
+      nlist.list = (unsigned long*) realloc(nlist.list, nlist.size*sizeof(unsigned long));
+      if (nlist.list == NULL)
+      {
+        fprintf(stdout, "ERROR: cannot allocate memory for the neighbor list\n");
+        exit(11);
+      }
+    }
+
+    /* ============================================ */
+    /*  Store the neighbors j > i                   */
+    /* ============================================ */
+    if (cells.n < 3)
+    {
+      for (j = i + 1; j < sim.N; j++)
+        if (in_list_radius(i, j)) nlist.list[n++] = j;
+    }
+    else
+    {
+      c = cells.cell[i];
+      for (dz = -1; dz <= 1; dz++)
+        for (dy = -1; dy <= 1; dy++)
+          for (dx = -1; dx <= 1; dx++)
+          {
+            cn = cell_list_neighbor(&cells, c, dx, dy, dz);
+            for (b = cells.start[cn]; b < cells.start[cn+1]; b++)
+            {
+              j = cells.index[b];
+              if (j > i && in_list_radius(i, j)) nlist.list[n++] = j;
+            }
+          }
+    }
+
+    /* ============================================ */
+    /*  Save the displacement at the build          */
+    /* ============================================ */
+    nlist.dx0[i] = atom.dx[i];
+    nlist.dy0[i] = atom.dy[i];
+    nlist.dz0[i] = atom.dz[i];
+  }
+  nlist.start[sim.N] = n;
+
+  nlist.rebuild = 0;
+  nlist.nbuild += 1;
+  nlist.npairs += (double)n;
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function rebuilds the list if any atom has moved more than    */
+/*  half of the skin since the last build.                             */
+/* ------------------------------------------------------------------- */
+void neighbor_list_update(void)
+{
+  unsigned long i;
+  double ddx, ddy, ddz, dr2;
+  double limit = 0.25*sim.skin*sim.skin;
+
+  if (!nlist.rebuild)
+  {
+    for (i = 0; i < sim.N; i++)
+    {
+      ddx = atom.dx[i] - nlist.dx0[i];
+      ddy = atom.dy[i] - nlist.dy0[i];
+      ddz = atom.dz[i] - nlist.dz0[i];
+      dr2 = ddx*ddx + ddy*ddy + ddz*ddz;
+      if (dr2 > limit)
+      {
+        nlist.rebuild = 1;
+        break;
+      }
+    }
+  }
+  if (nlist.rebuild) neighbor_list_build();
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function frees the memory of the neighbor list                */
+/* ------------------------------------------------------------------- */
+void neighbor_list_free(void)
+{
+  free(nlist.start);
+  free(nlist.list);
+  free(nlist.dx0);
+  free(nlist.dy0);
+  free(nlist.dz0);
+  nlist.start = NULL;
+  nlist.list = NULL;
+}
@@ -23,14 +23,17 @@
 #include "includes.h"
 
 int    scale_velocities(double);
-int    verlet1(void);
-int    verlet2(void);
 int    rdf_accumulate(tak_histogram*);
 int    finalize_file(tak_histogram*, double);
-double forces();
-double kinetic_energy();
+double forces_verlet(double*, tak_histogram*);
 double temperature(double);
 void   write_trr(unsigned long, int);
+void   output_log_printf(const char*, ...);
+const char* timers_rates(void);
+int    checkpoint_write(int, unsigned long, tak_histogram*, double);
+void   checkpoint_restore_rdf(tak_histogram*, double*);
+int    checkpoint_exit(int, unsigned long, tak_histogram*, double);
+bool   checkpoint_stop(void);
 
 int nvemd()
 {
@@ -38,29 +41,42 @@ int nvemd()
   unsigned long rescale_freq = 10;
   double ke, pe, T, P, Pave;
   double Nrdfcalls;
+  unsigned long first_eq = 1, first_pr = 1;
   tak_histogram *hrdf=NULL;
-  FILE *fp;
+  bool rdf_step;
+  bool rdf_fused = (sim.rdfmax <= sim.rc); //every pair within rdfmax is in the force pass
+
+  /* ============================================ */
+  /* Continue after the step of the checkpoint    */
+  /* when restarting.                             */
+  /* ============================================ */
+  if (ckpt.restart)
+  {
+    if (ckpt.phase == 0) first_eq = ckpt.step + 1;
+    else
+    {
+      first_eq = sim.eq + 1;
+      first_pr = ckpt.step + 1;
+    }
+  }
 
   /* ============================================ */
   /* Write Interation 0 and write to file.        */
   /* ============================================ */
-  // Note, pe and virial were calculated in main() for the
-  // initial configuration. They were stored in iprop.
-  P = sim.rho * iprop.T + 1.0 / 3.0 / pow(sim.length, 3.0) * iprop.virial + sim.ptail;
-  fp = fopen(sim.outputfile, "a");
-  fprintf(fp, "%-13lu    %13.6lf    %13.6lf    %13.6lf    %13.6lf    %13.6lf    %13.6lf    %13.6lf\n", (unsigned long)0, iprop.T, iprop.T, P, P, iprop.ke / (double)sim.N, iprop.pe / (double)sim.N + sim.utail, (iprop.ke + iprop.pe) / (double)sim.N + sim.utail);
-  fflush(fp);
-  fclose(fp);
+  if (!ckpt.restart)
+  {
+    // Note, pe and virial were calculated in main() for the
+    // initial configuration. They were stored in iprop.
+    P = sim.rho * iprop.T + 1.0 / 3.0 / pow(sim.length, 3.0) * iprop.virial + sim.ptail;
+    output_log_printf("%-13lu    %13.6lf    %13.6lf    %13.6lf    %13.6lf    %13.6lf    %13.6lf    %13.6lf%s\n", (unsigned long)0, iprop.T, iprop.T, P, P, iprop.ke / (double)sim.N, iprop.pe / (double)sim.N + sim.utail, (iprop.ke + iprop.pe) / (double)sim.N + sim.utail, timers_rates());
+  }
 
   /* ------------------------------------------------------------------- */
   /*  Perform equilibration steps                                        */
   /* ------------------------------------------------------------------- */
-  for (i = 1; i <= sim.eq; i++)
+  for (i = first_eq; i <= sim.eq; i++)
   {
-    verlet1();               //first half of velocity verlet algorithm
-    pe=forces();             //calculate the forces
-    verlet2();               //second half of velocity verlet algorithm
-    ke = kinetic_energy();   //calculate the kinetic energy
+    pe = forces_verlet(&ke, NULL); //velocity verlet step, forces, and kinetic energy
     T = temperature(ke);     //calculate the temperature
     
 	  /* ============================================ */
@@ -81,10 +97,7 @@ int nvemd()
     {
       P = sim.rho * iprop.T + 1.0 / 3.0 / pow(sim.length, 3.0) * iprop.virial + sim.ptail;
       Pave = sim.rho * aprop.T / (double)i + 1.0 / 3.0 / pow(sim.length, 3.0) * aprop.virial / (double)i + sim.ptail;
-      fp = fopen(sim.outputfile, "a");
-      fprintf(fp, "%-13lu    %13.6lf    %13.6lf    %13.6lf    %13.6lf    %13.6lf    %13.6lf    %13.6lf\n", (unsigned long)i, iprop.T, aprop.T/(double)i, P, Pave, iprop.ke/(double)sim.N, iprop.pe / (double)sim.N + sim.utail, (iprop.ke + iprop.pe) / (double)sim.N + sim.utail);
-      fflush(fp);
-      fclose(fp);
+      output_log_printf("%-13lu    %13.6lf    %13.6lf    %13.6lf    %13.6lf    %13.6lf    %13.6lf    %13.6lf%s\n", (unsigned long)i, iprop.T, aprop.T/(double)i, P, Pave, iprop.ke/(double)sim.N, iprop.pe / (double)sim.N + sim.utail, (iprop.ke + iprop.pe) / (double)sim.N + sim.utail, timers_rates());
       fprintf(stdout, "Equilibration Step %-lu\n", i);
     }
     
@@ -108,19 +121,41 @@ int nvemd()
       if (i%sim.movie == 0) write_trr(i, 0);
     }
 
+    /* ============================================ */
+    /*  Write a checkpoint at the interval          */
+    /*  specified in the input file                 */
+    /* ============================================ */
+    if (ckpt.interval && i % ckpt.interval == 0) checkpoint_write(0, i, NULL, 0.0);
+
+    /* ============================================ */
+    /*  Stop cleanly if a signal was caught or the  */
+    /*  walltime budget is nearly used              */
+    /* ============================================ */
+    if (checkpoint_stop())
+    {
+      checkpoint_exit(0, i, NULL, 0.0);
+      finalize_file(NULL, 0.0);
+      return(0);
+    }
+
   }
 
   /* ------------------------------------------------------------------- */
-  /*  Reset accumulators for production steps                            */
+  /*  Reset accumulators for production steps unless restarting in       */
+  /*  production, when the checkpoint holds them.                        */
   /* ------------------------------------------------------------------- */
-  aprop.pe = 0.0;
-  aprop.ke = 0.0;
-  aprop.T = 0.0;
-  aprop.virial = 0.0;
-  for (i = 0; i < sim.N; i++) {
-    atom[i].dx = 0.0;
-    atom[i].dy = 0.0;
-    atom[i].dz = 0.0;
+  if (first_pr == 1)
+  {
+    aprop.pe = 0.0;
+    aprop.ke = 0.0;
+    aprop.T = 0.0;
+    aprop.virial = 0.0;
+    for (i = 0; i < sim.N; i++) {
+      atom.dx[i] = 0.0;
+      atom.dy[i] = 0.0;
+      atom.dz[i] = 0.0;
+    }
+    nlist.rebuild = 1; //the list displacements are measured from dx, dy, dz
   }
   /* ------------------------------------------------------------------- */
   /*  Initialize rdf histogram                                           */
@@ -134,17 +169,16 @@ int nvemd()
       exit(10);
     }
     Nrdfcalls = 0;
+    if (first_pr > 1) checkpoint_restore_rdf(hrdf, &Nrdfcalls);
   }
 
   /* ------------------------------------------------------------------- */
   /*  Perform production steps                                           */
   /* ------------------------------------------------------------------- */
-    for (i = 1; i <= sim.pr; i++)
+    for (i = first_pr; i <= sim.pr; i++)
   {
-    verlet1();               //first half of velocity verlet algorithm
-    pe = forces();           //calculate the forces
-    verlet2();               //second half of velocity verlet algorithm
-    ke = kinetic_energy();   //calculate the kinetic energy
+    rdf_step = sim.rdf && i%sim.rdf == 0;
+    pe = forces_verlet(&ke, (rdf_step && rdf_fused) ? hrdf : NULL); //velocity verlet step, forces, kinetic energy, and rdf
     T = temperature(ke);     //calculate the temperature
 
 	  /* ============================================ */
@@ -161,13 +195,10 @@ int nvemd()
     aprop.virial += iprop.virial; //iprop.virial is set in forces
     
     
-    if (sim.rdf)//accumulate the rdf if specified in the input file (production steps only)
+    if (rdf_step)//accumulate the rdf if specified in the input file (production steps only)
     {
-      if (i%sim.rdf == 0)
-      {
-        Nrdfcalls += 1;
-        rdf_accumulate(hrdf);
-      }
+      Nrdfcalls += 1;
+      if (!rdf_fused) rdf_accumulate(hrdf); //binned by forces_verlet() otherwise
     }
 
     /* ============================================ */
@@ -178,10 +209,7 @@ int nvemd()
     {
       P = sim.rho * iprop.T + 1.0 / 3.0 / pow(sim.length, 3.0) * iprop.virial + sim.ptail;
       Pave = sim.rho * aprop.T / (double)i + 1.0 / 3.0 / pow(sim.length, 3.0) * aprop.virial / (double)i + sim.ptail;
-      fp = fopen(sim.outputfile, "a");
-      fprintf(fp, "%-13lu    %13.6lf    %13.6lf    %13.6lf    %13.6lf    %13.6lf    %13.6lf    %13.6lf\n", (unsigned long)i, iprop.T, aprop.T / (double)i, P, Pave, iprop.ke / (double)sim.N, iprop.pe / (double)sim.N + sim.utail, (iprop.ke + iprop.pe) / (double)sim.N + sim.utail);
-      fflush(fp);
-      fclose(fp);
+      output_log_printf("%-13lu    %13.6lf    %13.6lf    %13.6lf    %13.6lf    %13.6lf    %13.6lf    %13.6lf%s\n", (unsigned long)i, iprop.T, aprop.T / (double)i, P, Pave, iprop.ke / (double)sim.N, iprop.pe / (double)sim.N + sim.utail, (iprop.ke + iprop.pe) / (double)sim.N + sim.utail, timers_rates());
       fprintf(stdout, "Production Step    %-lu\n", i);
     }
 
@@ -193,13 +221,31 @@ int nvemd()
     {
       if (i%sim.movie == 0) write_trr(i, 1);
     }
+
+    /* ============================================ */
+    /*  Write a checkpoint at the interval          */
+    /*  specified in the input file                 */
+    /* ============================================ */
+    if (ckpt.interval && i % ckpt.interval == 0) checkpoint_write(1, i, hrdf, Nrdfcalls);
+
+    /* ============================================ */
+    /*  Stop cleanly if a signal was caught or the  */
+    /*  walltime budget is nearly used              */
+    /* ============================================ */
+    if (checkpoint_stop())
+    {
+      checkpoint_exit(1, i, hrdf, Nrdfcalls);
+      finalize_file(hrdf, Nrdfcalls);
+      return(0);
+    }
   }
 
   /* ------------------------------------------------------------------- */
   /*  Finalize the output file after all equilibration and production    */
   /*  steps are finished.  This calculates and write the averages to the */
-  /*  output file.                                                       */
+  /*  output file.  The final checkpoint is written first.               */
   /* ------------------------------------------------------------------- */
+  checkpoint_write(1, sim.pr, hrdf, Nrdfcalls);
   finalize_file(hrdf, Nrdfcalls);
 
   return(0);
@@ -17,7 +17,11 @@
 /* ======================================================================== */
 /* nvtmc.c                                                                  */
 /*                                                                          */
-/* This subroutine is the main driver for NVT MC simulations.               */
+/* This subroutine is the main driver for NVT MC simulations.  By default   */
+/* the properties are accumulated after every move.  If the sample keyword  */
+/* is given they are computed from scratch and accumulated only once every  */
+/* sample sweeps.  With "sweep checkerboard" each sweep is done in parallel */
+/* by checkerboard_sweep().                                                 */
 /* ======================================================================== */
 
 #include "includes.h"
@@ -26,46 +30,123 @@ bool   move(void);
 int    rdf_accumulate(tak_histogram*);
 int    finalize_file(tak_histogram*, double);
 double forces(void);
+void   atomic_pe_all(void);
 void   write_trr(unsigned long, int);
+void   output_log_printf(const char*, ...);
+int    checkpoint_write(int, unsigned long, tak_histogram*, double);
+void   checkpoint_restore_rdf(tak_histogram*, double*);
+int    checkpoint_exit(int, unsigned long, tak_histogram*, double);
+bool   checkpoint_stop(void);
 void   scale_delta(void);
+void   checkerboard_sweep(void);
+double wall_clock(void);
+const char* timers_rates(void);
+
+/* ------------------------------------------------------------------- */
+/*  This function adds the time, trial moves, and pair terms of the    */
+/*  sweep that started at wall_clock() t0 with the pair counters of    */
+/*  mccells at p0 to the timers.  The checkerboard counts its pairs.   */
+/* ------------------------------------------------------------------- */
+static void count_sweep(double t0, double p0)
+{
+  timers.trial += wall_clock() - t0;
+  timers.mctrials += (double)sim.N;
+  if (domains.n > 0) return;
+  if (mccells.grid.n >= 3) timers.pairs += mccells.npairs - mccells.nskipped - p0;
+  else timers.pairs += (double)sim.N * (double)(sim.N - 1);
+}
 
 int nvtmc()
 {
   unsigned long i, j;
   double P, Pave;
   int freq_scale_delta = 10;
-  FILE *fp;
+  int freq_recompute = 100;
   aprop.Nhist = 0;
   double Nrdfcalls;
+  double t0, p0;
+  unsigned long first_eq = 1, first_pr = 1;
   tak_histogram *hrdf = NULL;
 
+  /* ============================================ */
+  /* Continue after the step of the checkpoint    */
+  /* when restarting.                             */
+  /* ============================================ */
+  if (ckpt.restart)
+  {
+    if (ckpt.phase == 0) first_eq = ckpt.step + 1;
+    else
+    {
+      first_eq = sim.eq + 1;
+      first_pr = ckpt.step + 1;
+    }
+  }
+
   /* ============================================ */
   /* Write Interation 0 and write to file.        */
   /* ============================================ */
-  // Note, pe and virial were calculated in main() for the
-  // initial configuration. They were stored in iprop.
-  P = sim.rho * sim.T + 1.0 / 3.0 / pow(sim.length, 3.0) * iprop.virial + sim.ptail;
-  fp = fopen(sim.outputfile, "a");
-  fprintf(fp, "%-13lu    %13.6lf    %13.6lf    %13.6lf\n", (unsigned long)0, P, P, iprop.pe / (double)sim.N + sim.utail);
-  fflush(fp);
-  fclose(fp);
+  if (!ckpt.restart)
+  {
+    // Note, pe and virial were calculated in main() for the
+    // initial configuration. They were stored in iprop.
+    P = sim.rho * sim.T + 1.0 / 3.0 / pow(sim.length, 3.0) * iprop.virial + sim.ptail;
+    output_log_printf("%-13lu    %13.6lf    %13.6lf    %13.6lf%s\n", (unsigned long)0, P, P, iprop.pe / (double)sim.N + sim.utail, timers_rates());
+  }
 
   /* ------------------------------------------------------------------- */
   /*  Perform equilibration steps                                        */
   /* ------------------------------------------------------------------- */
-  for (i = 1; i <= sim.eq; i++)
+  for (i = first_eq; i <= sim.eq; i++)
   {
              
-    for (j = 0; j < sim.N; j++) // This loop performs sim.N moves per interation
+    /* ============================================ */
+    /*  A checkerboard sweep is accumulated once,   */
+    /*  weighted by its N moves                     */
+    /* ============================================ */
+    t0 = wall_clock();
+    p0 = mccells.npairs - mccells.nskipped;
+    if (domains.n > 0)
     {
-      move();
+      checkerboard_sweep();
+      if (!sim.sample)
+      {
+        aprop.pe += (double)sim.N * iprop.pe;
+        aprop.virial += (double)sim.N * iprop.virial;
+        aprop.pe2 += (double)sim.N * iprop.pe2;
+      }
+    }
+    else
+    {
+      for (j = 0; j < sim.N; j++) // This loop performs sim.N moves per interation
+      {
+        move();
 
-      /* ============================================ */
-      /*  Accumulate the properties for the step      */
-      /* ============================================ */
+        /* ============================================ */
+        /*  Accumulate the properties for the step      */
+        /*  unless they are sampled per sweep           */
+        /* ============================================ */
+        if (!sim.sample)
+        {
+          aprop.pe += iprop.pe;
+          aprop.virial += iprop.virial;
+          aprop.pe2 += iprop.pe2;
+        }
+      }
+    }
+    count_sweep(t0, p0);
+
+    /* ============================================ */
+    /*  Sample the properties at the interval       */
+    /*  specified in the input file                 */
+    /* ============================================ */
+    if (sim.sample && i % sim.sample == 0)
+    {
+      iprop.pe = forces();
+      iprop.pe2 = iprop.pe * iprop.pe;
       aprop.pe += iprop.pe;
       aprop.virial += iprop.virial;
       aprop.pe2 += iprop.pe2;
+      aprop.nsample += 1;
     }
 
     /* ============================================ */
@@ -76,13 +157,27 @@ int nvtmc()
     {
       Pave = sim.rho*sim.T + 1.0 / 3.0 / pow(sim.length, 3.0) * aprop.virial / (double)sim.N / (double)i + sim.ptail;
       P = sim.rho * sim.T + 1.0 / 3.0 / pow(sim.length, 3.0) * iprop.virial + sim.ptail;
-      fp = fopen(sim.outputfile, "a");
-      fprintf(fp, "%-13lu    %13.6lf    %13.6lf    %13.6lf\n", (unsigned long)i, P, Pave, iprop.pe / (double)sim.N + sim.utail);
-      fflush(fp);
-      fclose(fp);
+      if (sim.sample) Pave = (aprop.nsample > 0) ? sim.rho * sim.T + 1.0 / 3.0 / pow(sim.length, 3.0) * aprop.virial / (double)aprop.nsample + sim.ptail : P;
+      output_log_printf("%-13lu    %13.6lf    %13.6lf    %13.6lf%s\n", (unsigned long)i, P, Pave, iprop.pe / (double)sim.N + sim.utail, timers_rates());
       fprintf(stdout, "Equilibrium Step %-lu\n", i);
     }
 
+    /* ============================================ */
+    /*  Recompute the energy and virial from        */
+    /*  scratch to remove the round-off drift of    */
+    /*  the incremental updates in move(), unless   */
+    /*  the sample above has just done so           */
+    /* ============================================ */
+    if (i % freq_recompute == 0)
+    {
+      if (!(sim.sample && i % sim.sample == 0))
+      {
+        iprop.pe = forces();
+        iprop.pe2 = iprop.pe * iprop.pe;
+      }
+      if (mccells.grid.n >= 3) atomic_pe_all();
+    }
+
     /* ============================================ */
     /*  Scale delta to obtain 30% acceptance        */
     /* ============================================ */
@@ -96,18 +191,42 @@ int nvtmc()
     {
       if (i%sim.movie == 0) write_trr(i, 0);
     }
+
+    /* ============================================ */
+    /*  Write a checkpoint at the interval          */
+    /*  specified in the input file                 */
+    /* ============================================ */
+    if (ckpt.interval && i % ckpt.interval == 0) checkpoint_write(0, i, NULL, 0.0);
+
+    /* ============================================ */
+    /*  Stop cleanly if a signal was caught or the  */
+    /*  walltime budget is nearly used              */
+    /* ============================================ */
+    if (checkpoint_stop())
+    {
+      checkpoint_exit(0, i, NULL, 0.0);
+      finalize_file(NULL, 0.0);
+      return(0);
+    }
   }
 
   /* ------------------------------------------------------------------- */
-  /*  Reset accumulators for production steps                            */
+  /*  Reset accumulators for production steps unless restarting in       */
+  /*  production, when the checkpoint holds them.                        */
   /* ------------------------------------------------------------------- */
-  iprop.ntrys = 0;
-  iprop.naccept = 0;
-  aprop.ntrys = 0;
-  aprop.naccept = 0;
-  aprop.pe = 0.0;
-  aprop.virial = 0.0;
-  aprop.pe2 = 0.0;
+  if (first_pr == 1)
+  {
+    iprop.ntrys = 0;
+    iprop.naccept = 0;
+    aprop.ntrys = 0;
+    aprop.naccept = 0;
+    aprop.pe = 0.0;
+    aprop.virial = 0.0;
+    aprop.pe2 = 0.0;
+    aprop.nsample = 0;
+    mccells.npairs = 0.0;
+    mccells.nskipped = 0.0;
+  }
 
   /* ------------------------------------------------------------------- */
   /*  Initialize rdf histogram                                           */
@@ -121,23 +240,62 @@ int nvtmc()
       exit(10);
     }
     Nrdfcalls = 0;
+    if (first_pr > 1) checkpoint_restore_rdf(hrdf, &Nrdfcalls);
   }
 
   /* ------------------------------------------------------------------- */
   /*  Perform production steps                                           */
   /* ------------------------------------------------------------------- */
-  for (i = 1; i <= sim.pr; i++)
+  for (i = first_pr; i <= sim.pr; i++)
   {
-    for (j = 0; j < sim.N; j++) // This loop performs sim.N moves per interation (one MC sweep)
+    /* ============================================ */
+    /*  A checkerboard sweep is accumulated once,   */
+    /*  weighted by its N moves                     */
+    /* ============================================ */
+    t0 = wall_clock();
+    p0 = mccells.npairs - mccells.nskipped;
+    if (domains.n > 0)
     {
-      move(); 
+      checkerboard_sweep();
+      if (!sim.sample)
+      {
+        aprop.pe += (double)sim.N * iprop.pe;
+        aprop.virial += (double)sim.N * iprop.virial;
+        aprop.pe2 += (double)sim.N * iprop.pe2;
+      }
+    }
+    else
+    {
+      for (j = 0; j < sim.N; j++) // This loop performs sim.N moves per interation (one MC sweep)
+      {
+        move(); 
 
-	  /* ============================================ */
-	  /*  Accumulate the properties for the step      */
-	  /* ============================================ */
+        /* ============================================ */
+        /*  Accumulate the properties for the step      */
+        /*  unless they are sampled per sweep           */
+        /* ============================================ */
+        if (!sim.sample)
+        {
+          aprop.pe += iprop.pe;
+          aprop.virial += iprop.virial;
+          aprop.pe2 += iprop.pe2;
+        }
+      }
+    }
+    count_sweep(t0, p0);
+
+    /* ============================================ */
+    /*  Sample the properties at the interval       */
+    /*  specified in the input file                 */
+    /* ============================================ */
+    if (sim.sample && i % sim.sample == 0)
+    {
+      iprop.pe = forces();
+      iprop.pe2 = iprop.pe * iprop.pe;
       aprop.pe += iprop.pe;
       aprop.virial += iprop.virial;
       aprop.pe2 += iprop.pe2;
+      aprop.nsample += 1;
     }
 	
 	if (sim.rdf)//accumulate the rdf if specified in the input file (production steps only)
@@ -157,13 +315,27 @@ int nvtmc()
     {
       Pave = sim.rho * sim.T + 1.0 / 3.0 / pow(sim.length, 3.0) * aprop.virial / (double)sim.N / (double)(i) + sim.ptail;
       P = sim.rho * sim.T + 1.0 / 3.0 / pow(sim.length, 3.0) * iprop.virial + sim.ptail;
-      fp = fopen(sim.outputfile, "a");
-      fprintf(fp, "%-13lu    %13.6lf    %13.6lf    %13.6lf\n", (unsigned long)i, P, Pave, iprop.pe / (double)sim.N + sim.utail);
-      fflush(fp);
-      fclose(fp);
+      if (sim.sample) Pave = (aprop.nsample > 0) ? sim.rho * sim.T + 1.0 / 3.0 / pow(sim.length, 3.0) * aprop.virial / (double)aprop.nsample + sim.ptail : P;
+      output_log_printf("%-13lu    %13.6lf    %13.6lf    %13.6lf%s\n", (unsigned long)i, P, Pave, iprop.pe / (double)sim.N + sim.utail, timers_rates());
       fprintf(stdout, "Production Step %-lu\n", i);
     }
 
+    /* ============================================ */
+    /*  Recompute the energy and virial from        */
+    /*  scratch to remove the round-off drift of    */
+    /*  the incremental updates in move(), unless   */
+    /*  the sample above has just done so           */
+    /* ============================================ */
+    if (i % freq_recompute == 0)
+    {
+      if (!(sim.sample && i % sim.sample == 0))
+      {
+        iprop.pe = forces();
+        iprop.pe2 = iprop.pe * iprop.pe;
+      }
+      if (mccells.grid.n >= 3) atomic_pe_all();
+    }
+
     /* ============================================ */
     /*  Scale delta to obtain desired acceptance    */
     /* ============================================ */
@@ -177,13 +349,31 @@ int nvtmc()
     {
       if (i%sim.movie == 0) write_trr(i, 1);
     }
+
+    /* ============================================ */
+    /*  Write a checkpoint at the interval          */
+    /*  specified in the input file                 */
+    /* ============================================ */
+    if (ckpt.interval && i % ckpt.interval == 0) checkpoint_write(1, i, hrdf, Nrdfcalls);
+
+    /* ============================================ */
+    /*  Stop cleanly if a signal was caught or the  */
+    /*  walltime budget is nearly used              */
+    /* ============================================ */
+    if (checkpoint_stop())
+    {
+      checkpoint_exit(1, i, hrdf, Nrdfcalls);
+      finalize_file(hrdf, Nrdfcalls);
+      return(0);
+    }
   }
 
   /* ------------------------------------------------------------------- */
   /*  Finalize the output file after all equilibration and production    */
   /*  steps are finished.  This calculates and write the averages to the */
-  /*  output file.                                                       */
+  /*  output file.  The final checkpoint is written first.               */
   /* ------------------------------------------------------------------- */
+  checkpoint_write(1, sim.pr, hrdf, Nrdfcalls);
   finalize_file(hrdf, Nrdfcalls);
 
   return(0);
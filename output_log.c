@@ -0,0 +1,156 @@
+/* Copyright (C) 2017 Thomas Allen Knotts IV - All Rights Reserved          */
+/* This file is part of the program ljmcmd                                  */
+/*                                                                          */
+/* ljmcmd is free software: you can redistribute it and/or modify           */
+/* it under the terms of the GNU General Public License as published by     */
+/* the Free Software Foundation, either version 3 of the License, or        */
+/* (at your option) any later version.                                      */
+/*                                                                          */
+/* ljmcmd is distributed in the hope that it will be useful,                */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of           */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            */
+/* GNU General Public License for more details.                             */
+/*                                                                          */
+/* You should have received a copy of the GNU General Public License        */
+/* along with ljmcmd.  If not, see <http://www.gnu.org/licenses/>.          */
+
+/* ======================================================================== */
+/* output_log.c                                                             */
+/*                                                                          */
+/* This file contains the subroutines that write the property lines to the  */
+/* output file.  The file is opened once with a large user-space buffer     */
+/* instead of being opened and closed for every line.  The buffer is        */
+/* flushed when LOG_FLUSH_BYTES have been written or LOG_FLUSH_SECONDS      */
+/* have passed since the last flush, when output_log_flush() is called,     */
+/* and when the file is closed at the end of the run or at exit().  The     */
+/* bytes written to the file are the same as before.  When the I/O thread   */
+/* of async_io.c is running, the lines are formatted here and written by    */
+/* that thread through output_log_puts().                                   */
+/* ======================================================================== */
+
+#include "includes.h"
+#include <stdarg.h>
+
+/* =======================Constants============================== */
+#define LOG_BUFFER_SIZE (1 << 20)
+#define LOG_FLUSH_BYTES (1 << 16)
+#define LOG_FLUSH_SECONDS 10.0
+/* ============================================================= */
+
+static FILE *log_fp = NULL;
+static char *log_buffer = NULL;
+static unsigned long log_pending = 0;
+static time_t log_flushed;
+
+bool async_io_line(const char*);
+void async_io_drain(void);
+double wall_clock(void);
+
+/* ------------------------------------------------------------------- */
+/*  This function writes the buffer to the file.  It does not wait for */
+/*  the I/O thread, so the thread itself can call it.                  */
+/* ------------------------------------------------------------------- */
+static void flush_buffer(void)
+{
+  fflush(log_fp);
+  log_pending = 0;
+  log_flushed = time(NULL);
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function closes the output file after flushing the buffer     */
+/* ------------------------------------------------------------------- */
+void output_log_close(void)
+{
+  if (log_fp == NULL) return;
+  fclose(log_fp);
+  free(log_buffer);
+  log_fp = NULL;
+  log_buffer = NULL;
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function opens the output file for appending.  It must be     */
+/*  called after initialize_files() has written the header.            */
+/* ------------------------------------------------------------------- */
+int output_log_open(void)
+{
+  log_fp = fopen(sim.outputfile, "a");
+  if (log_fp == NULL)
+  {
+    fprintf(stdout, "ERROR: cannot open output file \"%s\"\n", sim.outputfile);
+    return(ERROR_FILE_NOT_FOUND);
+  }
+  log_buffer = (char*) malloc(LOG_BUFFER_SIZE);
+  if (log_buffer != NULL) setvbuf(log_fp, log_buffer, _IOFBF, LOG_BUFFER_SIZE);
+  log_pending = 0;
+  log_flushed = time(NULL);
+  atexit(output_log_close);
+  return(0);
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function returns the stream of the output file so that larger */
+/*  blocks, like the final positions, can be written directly.         */
+/* ------------------------------------------------------------------- */
+FILE* output_log_file(void)
+{
+  async_io_drain();
+  return(log_fp);
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function writes any buffered lines to the file                */
+/* ------------------------------------------------------------------- */
+void output_log_flush(void)
+{
+  if (log_fp == NULL) return;
+  async_io_drain();
+  flush_buffer();
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function writes a line to the output file and flushes the     */
+/*  buffer if the byte or time threshold has been reached.             */
+/* ------------------------------------------------------------------- */
+void output_log_puts(const char *line)
+{
+  size_t n = strlen(line);
+
+  fwrite(line, 1, n, log_fp);
+  log_pending += (unsigned long)n;
+
+  if (log_pending >= LOG_FLUSH_BYTES || difftime(time(NULL), log_flushed) >= LOG_FLUSH_SECONDS) flush_buffer();
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function formats one line for the output file.  The line is   */
+/*  queued for the I/O thread if it is running and written here if not */
+/*  or if it is too long for a queue slot.                             */
+/* ------------------------------------------------------------------- */
+void output_log_printf(const char *format, ...)
+{
+  va_list args;
+  char line[LOG_LINE_SIZE];
+  int n;
+  double t0 = wall_clock();
+
+  va_start(args, format);
+  n = vsnprintf(line, LOG_LINE_SIZE, format, args);
+  va_end(args);
+  if (n < 0) return;
+
+  if (n < LOG_LINE_SIZE)
+  {
+    if (!async_io_line(line)) output_log_puts(line);
+    timers.log += wall_clock() - t0;
+    return;
+  }
+
+  async_io_drain();
+  va_start(args, format);
+  n = vfprintf(log_fp, format, args);
+  va_end(args);
+  if (n > 0) log_pending += (unsigned long)n;
+  timers.log += wall_clock() - t0;
+}
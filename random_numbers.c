@@ -17,82 +17,164 @@
 /* ======================================================================== */
 /* random_numbers.c                                                         */
 /*                                                                          */
-/*	 This file contains functions that calculate random numbers             */
-/* between the range passed to the functions.  One function                 */
-/* returns a double and the other function returns an integer.              */
-/* The interval does not include the upper limit.  The algorithm            */
-/* is from Numberical Recipies.                                             */
+/* This file contains functions that calculate random numbers between the   */
+/* range passed to the functions.  One function returns a double and the    */
+/* other function returns an integer.  The interval does not include the    */
+/* limits.                                                                  */
 /*                                                                          */
-/* Before an random number is generated, the generator must be              */
-/* initialized by calling it with a negative seed.  Then, each              */
-/* call after that must be called with the same positive seed.              */
+/* The generator is the counter-based Philox4x32-10 of Salmon et al.,       */
+/* "Parallel Random Numbers: As Easy as 1, 2, 3" (SC11).  The n-th number   */
+/* of a stream is a pure function of the key, the stream id, and n, so a    */
+/* stream is only a struct ran_stream holding those values.  Independent    */
+/* streams with different ids can be used by different threads at the       */
+/* same time, the state can be written to and read from a file, and an      */
+/* array can be filled in a loop the compiler can vectorize.                */
+/*                                                                          */
+/* Before a random number is generated with ran_num_double(), the main      */
+/* stream must be initialized by calling it with a negative seed.  Then,    */
+/* each call after that must be called with a positive value.               */
 /* ======================================================================== */
 
+#include "includes.h"
+
 
 /* =======================Constants============================== */
-#define IM1 2147483563
-#define IM2 2147483399
-#define AM (1.0/IM1)
-#define IMM1 (IM1-1)
-#define IA1 40014
-#define IA2 40692
-#define IQ1 53668
-#define IQ2 52774
-#define IR1 12211
-#define IR2 3791
-#define NTAB 32
-#define NDIV (1+IMM1/NTAB)
-#define EPS 0.0
-#define RNMX 1.0
+#define PHILOX_M0 0xD2511F53u
+#define PHILOX_M1 0xCD9E8D57u
+#define PHILOX_W0 0x9E3779B9u
+#define PHILOX_W1 0xBB67AE85u
+#define PHILOX_ROUNDS 10
+#define RAN_LANES 8
+#define TWOM53 (1.0/9007199254740992.0)
 /* ============================================================= */
 
 /* ------------------------------------------------------------------- */
-/*  This function returns a double on the interval [range1, range2)    */
+/*  This function applies the Philox4x32-10 bijection to the counter   */
+/*  c with key k.  Every lane of the arrays is an independent block,   */
+/*  so the loops over l are vectorized by the compiler.                */
 /* ------------------------------------------------------------------- */
-double ran_num_double(long idum,double range1,double range2)
+static void philox_lanes(uint32_t c[4][RAN_LANES], uint32_t k0, uint32_t k1, int nl)
 {
- int j;
- long k;
- static long idum2=123456789;
- static long iy=0;
- static long iv[NTAB];
- double temp;
- 
-if (idum <= 0)
- { 
-  if (-(idum) < 1) idum=1;
-  else idum = -(idum);
-  
-  idum2=(idum);
- 
-  for (j=NTAB+7;j>=0;j--)
+  int r, l;
+  uint64_t p0, p1;
+  uint32_t t0, t1, t2, t3;
+
+  for (r = 0; r < PHILOX_ROUNDS; r++)
   {
-   k=(idum)/IQ1;
-   idum=IA1*(idum-k*IQ1)-IR1*k;
-   if (idum < 0) idum += IM1;
-   if (j < NTAB) iv[j] = idum;
+    for (l = 0; l < nl; l++)
+    {
+      p0 = (uint64_t)PHILOX_M0 * c[0][l];
+      p1 = (uint64_t)PHILOX_M1 * c[2][l];
+      t0 = (uint32_t)(p1 >> 32) ^ c[1][l] ^ k0;
+      t1 = (uint32_t)p1;
+      t2 = (uint32_t)(p0 >> 32) ^ c[3][l] ^ k1;
+      t3 = (uint32_t)p0;
+      c[0][l] = t0;
+      c[1][l] = t1;
+      c[2][l] = t2;
+      c[3][l] = t3;
+    }
+    k0 += PHILOX_W0;
+    k1 += PHILOX_W1;
   }
-iy=iv[0];
- }
- 
-k=(idum)/IQ1;
-idum=IA1*(idum-k*IQ1)-IR1*k;
- 
-if (idum < 0) idum += IM1;
-k=idum2/IQ2;
-idum2=IA2*(idum2-k*IQ2)-k*IR2;
- 
-if(idum2 < 0)
- idum2+=IM2;
- 
-j=iy/NDIV;
-iy=iv[j]-idum2;
-iv[j]=idum;
-if(iy<1)
- iy+=IMM1;
-temp=(double)AM*iy;
-    
-return range1+(range2-range1)*temp;
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function loads the counters of blocks b to b+nl-1 of a stream */
+/* ------------------------------------------------------------------- */
+static void philox_counters(uint32_t c[4][RAN_LANES], const struct ran_stream *rs, uint64_t b, int nl)
+{
+  int l;
+
+  for (l = 0; l < nl; l++)
+  {
+    c[0][l] = (uint32_t)(b + l);
+    c[1][l] = (uint32_t)((b + l) >> 32);
+    c[2][l] = (uint32_t)rs->id;
+    c[3][l] = (uint32_t)(rs->id >> 32);
+  }
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function converts two words to a double on the interval (0,1) */
+/* ------------------------------------------------------------------- */
+static double philox_to_double(uint32_t a, uint32_t b)
+{
+  return(((double)(((uint64_t)(a >> 5) << 26) | (b >> 6)) + 0.5)*TWOM53);
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function initializes a stream from a seed and a stream id     */
+/* ------------------------------------------------------------------- */
+void ran_stream_init(struct ran_stream *rs, long seed, uint64_t id)
+{
+  rs->key[0] = (uint32_t)(uint64_t)seed;
+  rs->key[1] = (uint32_t)((uint64_t)seed >> 32);
+  rs->id = id;
+  rs->n = 0;
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function returns a double on the interval (range1, range2)    */
+/*  from a stream.  Each block gives two numbers, so the second number */
+/*  of a block is kept in the stream.                                  */
+/* ------------------------------------------------------------------- */
+double ran_stream_double(struct ran_stream *rs, double range1, double range2)
+{
+  uint32_t c[4][RAN_LANES];
+  double temp;
+
+  if (rs->n & 1) temp = rs->next;
+  else
+  {
+    philox_counters(c, rs, rs->n >> 1, 1);
+    philox_lanes(c, rs->key[0], rs->key[1], 1);
+    temp = philox_to_double(c[0][0], c[1][0]);
+    rs->next = philox_to_double(c[2][0], c[3][0]);
+  }
+  rs->n++;
+
+  return(range1 + (range2 - range1)*temp);
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function fills u[0] to u[n-1] with doubles on the interval    */
+/*  (range1, range2) from a stream.  The numbers are the same as those */
+/*  of n calls to ran_stream_double().                                 */
+/* ------------------------------------------------------------------- */
+void ran_stream_fill(struct ran_stream *rs, double *u, unsigned long n, double range1, double range2)
+{
+  uint32_t c[4][RAN_LANES];
+  unsigned long i = 0, m;
+  int l, nl;
+
+  if (n > 0 && (rs->n & 1)) u[i++] = ran_stream_double(rs, range1, range2);
+  while (n - i >= 2)
+  {
+    m = (n - i) / 2;
+    nl = (m < RAN_LANES) ? (int)m : RAN_LANES;
+    philox_counters(c, rs, rs->n >> 1, nl);
+    philox_lanes(c, rs->key[0], rs->key[1], nl);
+    for (l = 0; l < nl; l++)
+    {
+      u[i + 2*l] = range1 + (range2 - range1)*philox_to_double(c[0][l], c[1][l]);
+      u[i + 2*l + 1] = range1 + (range2 - range1)*philox_to_double(c[2][l], c[3][l]);
+    }
+    i += 2*nl;
+    rs->n += 2*nl;
+  }
+  if (i < n) u[i] = ran_stream_double(rs, range1, range2);
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function returns a double on the interval (range1, range2)    */
+/*  from the main stream.  A negative idum reseeds the main stream.    */
+/* ------------------------------------------------------------------- */
+double ran_num_double(long idum,double range1,double range2)
+{
+  if (idum <= 0) ran_stream_init(&ran, idum, 0);
+
+  return(ran_stream_double(&ran, range1, range2));
 }
  
 /* ------------------------------------------------------------------- */
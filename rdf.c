@@ -17,72 +17,214 @@
 /* ======================================================================== */
 /* rdf.c                                                                    */
 /*                                                                          */
-/* This files contains subroutines to calculate and write the rdf.          */
+/* This files contains subroutines to calculate and write the rdf.  Only    */
+/* pairs closer than rdfmax are binned, so the pairs are found with a       */
+/* linked-cell list whose cells are at least rdfmax wide.  If the box holds */
+/* fewer than 3 such cells per side every pair is tested.  The squared      */
+/* distances are binned in batches without a sqrt.  The histograms of the   */
+/* threads other than 0 are allocated once with the cell list.              */
 /* ======================================================================== */
 
 #include "includes.h"
 
+int           cell_list_allocate(struct cell_struct*, double);
+void          cell_list_build(struct cell_struct*);
+unsigned long cell_list_neighbor(struct cell_struct*, unsigned long, int, int, int);
+void          cell_list_free(struct cell_struct*);
+double        wall_clock(void);
+
+static struct cell_struct rdf_cells;
+static tak_histogram **rdf_hist = NULL;   // histograms of the threads (entry 0 is h during rdf_accumulate)
+static int rdf_nhist = 0;
+
+#define RDF_BATCH 64    // number of squared distances binned at a time
 
 /* ------------------------------------------------------------------- */
-/* This subroutine is called at intervals specified in the input file  */
+/*  This function allocates the cell list of the rdf and a histogram   */
+/*  for each thread after the first                                    */
 /* ------------------------------------------------------------------- */
-int rdf_accumulate(tak_histogram *h)
+int rdf_allocate(void)
 {
-  double dr, dx, dy, dz;
-  unsigned long i, j;
-  int return_value=0;
+  int k;
 
-  /* ------------------------------------------------------------------- */
-  /* Loop around all pairs of atoms and determine the distance           */
-  /* ------------------------------------------------------------------- */
-  for (i = 0; i<sim.N - 1; i++)
+  rdf_nhist = atom.nthreads;
+  rdf_hist = (tak_histogram**)calloc(rdf_nhist, sizeof(tak_histogram*));
+  if (rdf_hist == NULL)
   {
-    for (j = i + 1; j<sim.N; j++)
+    fprintf(stdout, "ERROR: cannot allocate memory for the rdf histograms\n");
+    return(11);
+  }
+  for (k = 1; k < rdf_nhist; k++)
+  {
+    rdf_hist[k] = tak_histogram_calloc_uniform(sim.rdfN, sim.rdfmin, sim.rdfmax);
+    if (rdf_hist[k] == NULL)
     {
-      dx = atom[i].x - atom[j].x;
-      dy = atom[i].y - atom[j].y;
-      dz = atom[i].z - atom[j].z;
-
-      /* ============================================ */
-      /*         Minimum Image Convention             */
-      /* ============================================ */
-      if (fabs(dx)>(sim.length*0.5))
-      {
-        if (dx < 0.0)
-          dx += sim.length;
-        else
-          dx -= sim.length;
-      }
-      if (fabs(dy)>(sim.length*0.5))
-      {
-        if (dy < 0.0)
-          dy += sim.length;
-        else
-          dy -= sim.length;
-      }
-      if (fabs(dz)>(sim.length*0.5))
-      {
-        if (dz < 0.0)
-          dz += sim.length;
-        else
-          dz -= sim.length;
-      }
+      fprintf(stdout, "ERROR: cannot allocate memory for the rdf histograms\n");
+      return(11);
+    }
+  }
+  return(cell_list_allocate(&rdf_cells, sim.rdfmax));
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function frees the cell list and histograms of the rdf        */
+/* ------------------------------------------------------------------- */
+void rdf_free(void)
+{
+  int k;
 
-      dr = sqrt(dx*dx + dy*dy + dz*dz);
+  cell_list_free(&rdf_cells);
+  rdf_cells.n = 0;
+  for (k = 1; k < rdf_nhist; k++) if (rdf_hist[k] != NULL) tak_histogram_free(rdf_hist[k]);
+  free(rdf_hist);
+  rdf_hist = NULL;
+  rdf_nhist = 0;
+}
 
-      /* ============================================ */
-      /*  Increment the histogram for the calculated  */
-      /*  value of dr                                 */
-      /* ============================================ */
-      if (tak_histogram_increment(h, dr))
+/* ------------------------------------------------------------------- */
+/*  This function returns the histogram of thread t > 0 with its       */
+/*  counts set to zero.  Each thread clears its own histogram.         */
+/* ------------------------------------------------------------------- */
+tak_histogram* rdf_thread_histogram(int t)
+{
+  tak_histogram *h = rdf_hist[t];
+
+  memset(h->bin, 0, h->n*sizeof(double));
+  return(h);
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function returns the squared minimum image distance between   */
+/*  atoms i and j                                                      */
+/* ------------------------------------------------------------------- */
+static inline double pair_r2(unsigned long i, unsigned long j)
+{
+  double dx, dy, dz;
+
+  dx = atom.x[i] - atom.x[j];
+  dy = atom.y[i] - atom.y[j];
+  dz = atom.z[i] - atom.z[j];
+
+  /* ============================================ */
+  /*         Minimum Image Convention             */
+  /* ============================================ */
+  if (fabs(dx)>(sim.length*0.5))
+  {
+    if (dx < 0.0)
+      dx += sim.length;
+    else
+      dx -= sim.length;
+  }
+  if (fabs(dy)>(sim.length*0.5))
+  {
+    if (dy < 0.0)
+      dy += sim.length;
+    else
+      dy -= sim.length;
+  }
+  if (fabs(dz)>(sim.length*0.5))
+  {
+    if (dz < 0.0)
+      dz += sim.length;
+    else
+      dz -= sim.length;
+  }
+
+  return(dx*dx + dy*dy + dz*dz);
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function adds the squared distance between atoms i and j to   */
+/*  the batch in r2[] if it is less than rmax2 and bins the batch in h */
+/*  when it is full.  rmax2 is slightly larger than rdfmax squared so  */
+/*  that the histogram makes the exact test.                           */
+/* ------------------------------------------------------------------- */
+static inline void rdf_pair(tak_histogram *h, double *r2, int *m, unsigned long i, unsigned long j, double rmax2)
+{
+  double dr2 = pair_r2(i, j);
+
+  if (dr2 > rmax2) return;
+  r2[(*m)++] = dr2;
+  if (*m == RDF_BATCH)
+  {
+    tak_histogram_increment_batch_squared(h, r2, *m);
+    *m = 0;
+  }
+}
+
+/* ------------------------------------------------------------------- */
+/* This subroutine is called at intervals specified in the input file. */
+/* Each thread bins its pairs in its own histogram (thread 0 uses h)   */
+/* and the histograms are added to h at the end.                       */
+/* ------------------------------------------------------------------- */
+int rdf_accumulate(tak_histogram *h)
+{
+  static const int half_shell[13][3] = {
+    { 1, 0, 0}, { 1, 1, 0}, { 0, 1, 0}, {-1, 1, 0},
+    { 1, 0, 1}, { 1, 1, 1}, { 0, 1, 1}, {-1, 1, 1},
+    { 1,-1, 1}, { 0,-1, 1}, {-1,-1, 1}, { 0, 0, 1}, {-1, 0, 1} };
+  double rmax2 = sim.rdfmax*sim.rdfmax*(1.0 + 1.0e-12);
+  tak_histogram **hp = rdf_hist;
+  int k;
+  double t0 = wall_clock();
+
+  if (rdf_cells.n >= 3) cell_list_build(&rdf_cells);
+
+#pragma omp parallel private(k)
+  {
+    int t = 0;
+    double r2[RDF_BATCH];
+    int m = 0;
+    long i, c;
+    unsigned long j, a, b, cn[13];
+
+#ifdef _OPENMP
+    t = omp_get_thread_num();
+#endif
+
+    if (t == 0) hp[0] = h;
+    else rdf_thread_histogram(t);
+
+    /* ------------------------------------------------------------------- */
+    /* Loop around all pairs of atoms if there are too few cells           */
+    /* ------------------------------------------------------------------- */
+    if (rdf_cells.n < 3)
+    {
+#pragma omp for schedule(dynamic, 16)
+      for (i = 0; i < (long)sim.N - 1; i++)
+        for (j = i + 1; j<sim.N; j++) rdf_pair(hp[t], r2, &m, i, j, rmax2);
+    }
+
+    /* ------------------------------------------------------------------- */
+    /* Otherwise loop over the pairs in each cell and between each cell    */
+    /* and the 13 neighbors in its half shell                              */
+    /* ------------------------------------------------------------------- */
+    else
+    {
+#pragma omp for schedule(dynamic, 4)
+      for (c = 0; c < rdf_cells.ncells; c++)
       {
-        //fprintf(stdout, "Distance for rdf binning was outside of range. min=%lf, max=%lf, d=%lf", sim.rdfmin, sim.rdfmax, dr);
-        return_value = 1;
+        for (k = 0; k < 13; k++) cn[k] = cell_list_neighbor(&rdf_cells, c, half_shell[k][0], half_shell[k][1], half_shell[k][2]);
+        for (a = rdf_cells.start[c]; a < rdf_cells.start[c+1]; a++)
+        {
+          i = rdf_cells.index[a];
+          for (b = a + 1; b < rdf_cells.start[c+1]; b++) rdf_pair(hp[t], r2, &m, i, rdf_cells.index[b], rmax2);
+          for (k = 0; k < 13; k++)
+            for (b = rdf_cells.start[cn[k]]; b < rdf_cells.start[cn[k]+1]; b++) rdf_pair(hp[t], r2, &m, i, rdf_cells.index[b], rmax2);
+        }
       }
     }
+    tak_histogram_increment_batch_squared(hp[t], r2, m);
   }
 
-  return(return_value);
+  /* ------------------------------------------------------------------- */
+  /* Add the histograms of the other threads to h                        */
+  /* ------------------------------------------------------------------- */
+  tak_histogram_reduce(h, hp, rdf_nhist);
+  hp[0] = NULL;
+
+  timers.rdf += wall_clock() - t0;
+  return(0);
 }
 
 /* ------------------------------------------------------------------- */
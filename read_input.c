@@ -64,6 +64,17 @@ int read_input(char* fn_i, char* fn_o, char* input_errors)
   /* ------------------------------------------------------------------- */
   strcpy(sim.inputfile, fn_i);
   strcpy(sim.outputfile, fn_o);
+  sim.skin = 0.3;
+  sim.threads = 0;
+  sim.sample = 0;
+  strcpy(sim.sweep, "serial");
+  strcpy(sim.asyncio, "off");
+  sim.rates = 0;
+  ckpt.file[0] = '\0';
+  ckpt.interval = 0;
+  ckpt.restartfile[0] = '\0';
+  ckpt.restart = 0;
+  ckpt.walltime = 0.0;
  
 
   /* ------------------------------------------------------------------- */
@@ -331,13 +342,14 @@ int read_input(char* fn_i, char* fn_o, char* input_errors)
       }
       strcpy(sim.moviefile, keyvalue);
 
-      //check to see if the file has a .trr extention
+      //check to see if the file has a .trr or .xtc extention, which sets the format
       ext = strrchr(sim.moviefile, '.'); //gets the location of the pointer to the .
-      if (!ext || strcmp(ext+1,"trr"))   //if no . or not equal to .trr
+      if (!ext || (strcmp(ext+1,"trr") && strcmp(ext+1,"xtc")))   //if no . or not equal to .trr or .xtc
       {
-        fprintf(stdout, "The movie file must have a .trr extention.\n");
+        fprintf(stdout, "The movie file must have a .trr or .xtc extention.\n");
         return(ERROR_INPUT_FILE);
       }
+      strcpy(sim.movieformat, ext+1);
       token = strtok(NULL, " \t\n"); //read the next string on the line
       if (token == NULL)
       {
@@ -410,6 +422,132 @@ int read_input(char* fn_i, char* fn_o, char* input_errors)
       }
     }
 
+    /* -------------------------------------- */
+    /* keyword: skin                          */
+    /* number of keyvalues required: 1        */
+    /* -------------------------------------- */
+    else if (!strcmp("skin", keyword))
+    {
+      if (!(sscanf(keyvalue, "%lf%c", &sim.skin, &junk) == 1) || sim.skin < 0.0)
+      {
+        fprintf(stdout, "The value of keyword \"skin\" in input file \"%s\" is not a valid number.\n", fn_i);
+        return(ERROR_INPUT_FILE);
+      }
+    }
+
+    /* -------------------------------------- */
+    /* keyword: threads                       */
+    /* number of keyvalues required: 1        */
+    /* -------------------------------------- */
+    else if (!strcmp("threads", keyword))
+    {
+      if (!(sscanf(keyvalue, "%d%c", &sim.threads, &junk) == 1) || sim.threads < 0)
+      {
+        fprintf(stdout, "The value of keyword \"threads\" in input file \"%s\" is not a valid number.\n", fn_i);
+        return(ERROR_INPUT_FILE);
+      }
+    }
+
+    /* -------------------------------------- */
+    /* keyword: sample                        */
+    /* number of keyvalues required: 1        */
+    /* -------------------------------------- */
+    else if (!strcmp("sample", keyword))
+    {
+      if (!(sscanf(keyvalue, "%u%c", &sim.sample, &junk) == 1))
+      {
+        fprintf(stdout, "The interval of keyword \"sample\" in input file \"%s\" is not a valid.\n", fn_i);
+        return(ERROR_INPUT_FILE);
+      }
+    }
+
+    /* -------------------------------------- */
+    /* keyword: sweep                         */
+    /* number of keyvalues required: 1        */
+    /* -------------------------------------- */
+    else if (!strcmp("sweep", keyword))
+    {
+      if (strcmp(keyvalue, "serial") && strcmp(keyvalue, "checkerboard"))
+      {
+        fprintf(stdout, "The value of keyword \"sweep\" in input file \"%s\" must be \"serial\" or \"checkerboard\".\n", fn_i);
+        return(ERROR_INPUT_FILE);
+      }
+      strcpy(sim.sweep, keyvalue);
+    }
+
+    /* -------------------------------------- */
+    /* keyword: asyncio                       */
+    /* number of keyvalues required: 1        */
+    /* -------------------------------------- */
+    else if (!strcmp("asyncio", keyword))
+    {
+      if (strcmp(keyvalue, "off") && strcmp(keyvalue, "block") && strcmp(keyvalue, "drop"))
+      {
+        fprintf(stdout, "The value of keyword \"asyncio\" in input file \"%s\" must be \"off\", \"block\", or \"drop\".\n", fn_i);
+        return(ERROR_INPUT_FILE);
+      }
+      strcpy(sim.asyncio, keyvalue);
+    }
+
+    /* -------------------------------------- */
+    /* keyword: rates                         */
+    /* number of keyvalues required: 1        */
+    /* -------------------------------------- */
+    else if (!strcmp("rates", keyword))
+    {
+      if (strcmp(keyvalue, "off") && strcmp(keyvalue, "on"))
+      {
+        fprintf(stdout, "The value of keyword \"rates\" in input file \"%s\" must be \"off\" or \"on\".\n", fn_i);
+        return(ERROR_INPUT_FILE);
+      }
+      sim.rates = !strcmp(keyvalue, "on");
+    }
+
+    /* -------------------------------------- */
+    /* keyword: checkpoint                    */
+    /* number of keyvalues required: 2        */
+    /* -------------------------------------- */
+    else if (!strcmp("checkpoint", keyword))
+    {
+      strcpy(ckpt.file, keyvalue);
+      token = strtok(NULL, " \t\n"); //read the next string on the line
+      if (token == NULL)
+      {
+        fprintf(stdout, "No interval was specified for keyword \"checkpoint\" in input file \"%s\"\n", fn_i);
+        return(ERROR_INPUT_FILE);
+      }
+      if (!(sscanf(token, "%u%c", &ckpt.interval, &junk) == 1))
+      {
+        fprintf(stdout, "The interval of keyword \"checkpoint\" in input file \"%s\" is not a valid.\n", fn_i);
+        return(ERROR_INPUT_FILE);
+      }
+    }
+
+    /* -------------------------------------- */
+    /* keyword: restart                       */
+    /* number of keyvalues required: 1        */
+    /* -------------------------------------- */
+    else if (!strcmp("restart", keyword))
+    {
+      strcpy(ckpt.restartfile, keyvalue);
+      ckpt.restart = 1;
+    }
+
+    /* -------------------------------------- */
+    /* keyword: walltime                      */
+    /* number of keyvalues required: 1        */
+    /* -------------------------------------- */
+    else if (!strcmp("walltime", keyword))
+    {
+      unsigned int hh, mm, ss;
+      if (sscanf(keyvalue, "%u:%u:%u%c", &hh, &mm, &ss, &junk) == 3) ckpt.walltime = 3600.0*hh + 60.0*mm + ss; //hh:mm:ss
+      else if (!(sscanf(keyvalue, "%lf%c", &ckpt.walltime, &junk) == 1) || ckpt.walltime < 0.0) //seconds
+      {
+        fprintf(stdout, "The value of keyword \"walltime\" in input file \"%s\" must be seconds or hh:mm:ss.\n", fn_i);
+        return(ERROR_INPUT_FILE);
+      }
+    }
+
     /* -------------------------------------- */
     /* keyword is not found                   */
     /* -------------------------------------- */
@@ -491,6 +629,12 @@ int read_input(char* fn_i, char* fn_o, char* input_errors)
     return(ERROR_INPUT_FILE);
   }
 
+  if (!strcmp(sim.type, "mc") && sim.sample > sim.pr)
+  {
+    fprintf(stdout, "The interval of keyword \"sample\" in input file \"%s\" is larger than psteps.\n", fn_i);
+    return(ERROR_INPUT_FILE);
+  }
+
   if (!(output_flag) || !(movie_flag) || !(seed_flag) || !(coord_flag) || !(vel_flag))
   {
     if (keyword_flag)
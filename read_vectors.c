@@ -0,0 +1,293 @@
+/* Copyright (C) 2017 Thomas Allen Knotts IV - All Rights Reserved          */
+/* This file is part of the program ljmcmd                                  */
+/*                                                                          */
+/* ljmcmd is free software: you can redistribute it and/or modify           */
+/* it under the terms of the GNU General Public License as published by     */
+/* the Free Software Foundation, either version 3 of the License, or        */
+/* (at your option) any later version.                                      */
+/*                                                                          */
+/* ljmcmd is distributed in the hope that it will be useful,                */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of           */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            */
+/* GNU General Public License for more details.                             */
+/*                                                                          */
+/* You should have received a copy of the GNU General Public License        */
+/* along with ljmcmd.  If not, see <http://www.gnu.org/licenses/>.          */
+
+/* ======================================================================== */
+/* read_vectors.c                                                           */
+/*                                                                          */
+/* This file contains the loader for coordinate and velocity files.  The    */
+/* whole file is mapped into memory (or read with one fread where mmap is   */
+/* not available), the line starts are found with memchr, and the lines are */
+/* parsed in parallel.  Numbers with at most 19 digits and a decimal        */
+/* exponent of at most 22 are converted exactly with one multiplication or  */
+/* division by a power of ten; all other numbers are passed to strtod, so   */
+/* the values are the same as those read by sscanf("%lf").                  */
+/*                                                                          */
+/* A file may also be in a compact binary format: the 8 characters          */
+/* "LJMDMCVB", the number of vectors n as an unsigned 64 bit integer, and   */
+/* then n x values, n y values, and n z values as doubles.  All values are  */
+/* in the byte order of the machine.                                        */
+/* ======================================================================== */
+
+#include "includes.h"
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#define HAVE_MMAP 1
+#endif
+
+/* =======================Constants============================== */
+#define VECTORS_MAGIC "LJMDMCVB"
+#define VECTORS_HEADER 16
+#define MAX_DIGITS 19
+/* ============================================================= */
+
+static const double exact_pow10[23] = {
+  1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+/* ------------------------------------------------------------------- */
+/*  This structure holds the contents of a file in memory              */
+/* ------------------------------------------------------------------- */
+struct file_image {
+  const char      *data;                /* contents of the file        */
+  size_t          size;                 /* size of the file            */
+  bool            mapped;               /* true if data was mmapped    */
+};
+
+/* ------------------------------------------------------------------- */
+/*  This function loads the file fn into f.  It returns 0,             */
+/*  ERROR_FILE_NOT_FOUND if the file cannot be opened, or 11 if memory */
+/*  cannot be allocated.                                               */
+/* ------------------------------------------------------------------- */
+static int file_load(const char *fn, struct file_image *f)
+{
+  FILE *fp;
+  long end;
+  char *buffer;
+
+  f->data = NULL;
+  f->size = 0;
+  f->mapped = false;
+
+#ifdef HAVE_MMAP
+  int fd;
+  struct stat st;
+  void *p;
+
+  fd = open(fn, O_RDONLY);
+  if (fd < 0) return(ERROR_FILE_NOT_FOUND);
+  if (fstat(fd, &st) == 0 && st.st_size > 0)
+  {
+    p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p != MAP_FAILED)
+    {
+      close(fd);
+      f->data = (const char*) p;
+      f->size = (size_t)st.st_size;
+      f->mapped = true;
+      return(0);
+    }
+  }
+  close(fd);
+#endif
+
+  fp = fopen(fn, "rb");
+  if (fp == NULL) return(ERROR_FILE_NOT_FOUND);
+  fseek(fp, 0, SEEK_END);
+  end = ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+  if (end <= 0)
+  {
+    fclose(fp);
+    return(0);
+  }
+  buffer = (char*) malloc((size_t)end);
+  if (buffer == NULL)
+  {
+    fclose(fp);
+    fprintf(stdout, "ERROR: cannot allocate memory for file \"%s\"\n", fn);
+    return(11);
+  }
+  f->size = fread(buffer, 1, (size_t)end, fp);
+  f->data = buffer;
+  fclose(fp);
+  return(0);
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function releases the memory of f                             */
+/* ------------------------------------------------------------------- */
+static void file_unload(struct file_image *f)
+{
+#ifdef HAVE_MMAP
+  if (f->mapped)
+  {
+    munmap((void*)f->data, f->size);
+    return;
+  }
+#endif
+  free((void*)f->data);
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function parses the number that starts at *pp, skipping       */
+/*  blanks but not the end of the line.  end is the end of the line.   */
+/*  On success the number is stored in v, *pp is moved past it, and    */
+/*  true is returned.                                                  */
+/* ------------------------------------------------------------------- */
+static bool parse_double(const char **pp, const char *end, double *v)
+{
+  const char *p = *pp, *start;
+  uint64_t m = 0;
+  int ndigits = 0, e = 0, esign = 1, eval = 0;
+  bool neg = false, digits = false;
+  char token[MAX_LINE];
+  char *stop;
+  size_t len;
+
+  while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\v' || *p == '\f')) p++;
+  if (p == end) return(false);
+  start = p;
+
+  /* ============================================ */
+  /*  Fast path: [sign]digits[.digits][e[sign]n]  */
+  /* ============================================ */
+  if (*p == '-' || *p == '+') neg = (*p++ == '-');
+  while (p < end && *p >= '0' && *p <= '9')
+  {
+    m = 10*m + (uint64_t)(*p++ - '0');
+    ndigits++;
+    digits = true;
+  }
+  if (p < end && *p == '.')
+  {
+    p++;
+    while (p < end && *p >= '0' && *p <= '9')
+    {
+      m = 10*m + (uint64_t)(*p++ - '0');
+      ndigits++;
+      e--;
+      digits = true;
+    }
+  }
+  if (digits && p < end && (*p == 'e' || *p == 'E'))
+  {
+    const char *q = p + 1;
+    if (q < end && (*q == '-' || *q == '+')) esign = (*q++ == '-') ? -1 : 1;
+    if (q < end && *q >= '0' && *q <= '9')
+    {
+      while (q < end && *q >= '0' && *q <= '9' && eval < 10000) eval = 10*eval + (*q++ - '0');
+      e += esign*eval;
+      p = q;
+    }
+  }
+  if (digits && ndigits <= MAX_DIGITS && m <= ((uint64_t)1 << 53) && e >= -22 && e <= 22 &&
+      (p == end || !(isalnum((unsigned char)*p) || *p == '.')))
+  {
+    *v = (e < 0) ? (double)m / exact_pow10[-e] : (double)m * exact_pow10[e];
+    if (neg) *v = -*v;
+    *pp = p;
+    return(true);
+  }
+
+  /* ============================================ */
+  /*  Anything else is converted by strtod        */
+  /* ============================================ */
+  p = start;
+  while (p < end && !isspace((unsigned char)*p)) p++;
+  len = (size_t)(p - start);
+  if (len >= MAX_LINE) len = MAX_LINE - 1;
+  memcpy(token, start, len);
+  token[len] = '\0';
+  *v = strtod(token, &stop);
+  if (stop == token) return(false);
+  *pp = start + (stop - token);
+  return(true);
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function reads up to n vectors from the file fn into x, y,    */
+/*  and z.  A text file has one vector per line.  count is set to the  */
+/*  number of lines (or binary vectors) in the file, up to n, and bad  */
+/*  to the first line that does not hold three numbers, or to count if */
+/*  every line does.  It returns 0, ERROR_FILE_NOT_FOUND, or 11.       */
+/* ------------------------------------------------------------------- */
+int read_vectors(const char *fn, double *x, double *y, double *z, unsigned long n, unsigned long *count, unsigned long *bad)
+{
+  struct file_image f;
+  unsigned long nlines, first_bad;
+  const char **line;
+  const char *p, *end;
+  uint64_t nb;
+  long i;
+  int return_flag;
+
+  return_flag = file_load(fn, &f);
+  if (return_flag) return(return_flag);
+  *count = 0;
+  *bad = 0;
+
+  /* ------------------------------------------------------------------- */
+  /*  Binary format                                                      */
+  /* ------------------------------------------------------------------- */
+  if (f.size >= VECTORS_HEADER && !memcmp(f.data, VECTORS_MAGIC, 8))
+  {
+    memcpy(&nb, f.data + 8, sizeof(nb));
+    if (nb > (f.size - VECTORS_HEADER) / (3*sizeof(double))) nb = 0; //truncated
+    *count = (nb < n) ? (unsigned long)nb : n;
+    *bad = *count;
+    memcpy(x, f.data + VECTORS_HEADER, *count*sizeof(double));
+    memcpy(y, f.data + VECTORS_HEADER + nb*sizeof(double), *count*sizeof(double));
+    memcpy(z, f.data + VECTORS_HEADER + 2*nb*sizeof(double), *count*sizeof(double));
+    file_unload(&f);
+    return(0);
+  }
+
+  /* ------------------------------------------------------------------- */
+  /*  Text format: find the start of the first n lines.  A last line     */
+  /*  without a newline counts only if it is not empty.                  */
+  /* ------------------------------------------------------------------- */
+  line = (const char**) malloc((n + 1)*sizeof(const char*));
+  if (line == NULL)
+  {
+    file_unload(&f);
+    fprintf(stdout, "ERROR: cannot allocate memory for file \"%s\"\n", fn);
+    return(11);
+  }
+  p = f.data;
+  end = f.data + f.size;
+  nlines = 0;
+  while (nlines < n && p < end)
+  {
+    line[nlines++] = p;
+    p = (const char*) memchr(p, '\n', (size_t)(end - p));
+    p = (p == NULL) ? end : p + 1;
+  }
+  line[nlines] = p;
+
+  /* ------------------------------------------------------------------- */
+  /*  Parse the lines in parallel and find the first bad one             */
+  /* ------------------------------------------------------------------- */
+  first_bad = nlines;
+#pragma omp parallel for schedule(static) reduction(min:first_bad)
+  for (i = 0; i < (long)nlines; i++)
+  {
+    const char *q = line[i];
+    const char *eol = line[i + 1];
+    if (eol > q && eol[-1] == '\n') eol--;
+    if (!parse_double(&q, eol, &x[i]) || !parse_double(&q, eol, &y[i]) || !parse_double(&q, eol, &z[i]))
+      if ((unsigned long)i < first_bad) first_bad = (unsigned long)i;
+  }
+
+  *count = nlines;
+  *bad = first_bad;
+  free(line);
+  file_unload(&f);
+  return(0);
+}
@@ -32,9 +32,9 @@ int scale_velocities(double temp)
 	unsigned long i;
 	for (i=0; i<sim.N; i++)
 	{
-		atom[i].vx = atom[i].vx*scale;
-		atom[i].vy = atom[i].vy*scale;
-		atom[i].vz = atom[i].vz*scale;
+		atom.vx[i] = atom.vx[i]*scale;
+		atom.vy[i] = atom.vy[i]*scale;
+		atom.vz[i] = atom.vz[i]*scale;
 	}
   return(0);
 }
@@ -30,6 +30,12 @@ typedef struct{
   double bin_width; //Bin width
   double *vbin;     //Mid point value of bin
   double *bin;      //Accumulating value
+  double inv_width; //Inverse of the bin width
+  double *edge;     //x is in bin i if edge[i] <= x < edge[i+1] (n+1 values, uniform histograms only)
+  double *edge2;    //x*x is in bin i if edge2[i] <= x*x < edge2[i+1] (n+1 values, uniform histograms only)
+  int ngrid;        //Number of cells in the lookup table of the squared values
+  double grid_inv;  //Inverse width of the cells in the lookup table
+  int *grid;        //Lowest bin that a squared value in each cell can fall in
 }tak_histogram;
 
 tak_histogram* tak_histogram_alloc             (int n);
@@ -38,6 +44,10 @@ tak_histogram* tak_histogram_calloc_uniform    (int n, double xmin, double xmax)
 int tak_histogram_index_find                   (tak_histogram *h,double x,int *index);
 int tak_histogram_increment                    (tak_histogram *h, double x);
 int tak_histogram_accumulate                   (tak_histogram *h, double x, double weight);
+int tak_histogram_increment_batch              (tak_histogram *h, const double *x, int n);
+int tak_histogram_increment_batch_squared      (tak_histogram *h, const double *x2, int n);
+int tak_histogram_merge                        (tak_histogram *dest, const tak_histogram *src);
+int tak_histogram_reduce                       (tak_histogram *dest, tak_histogram **src, int n);
 int tak_histogram_fwrite                       (FILE *fp, tak_histogram *h);
 void tak_histogram_free                        (tak_histogram *h);
 int tak_histogram_equal_bins_p                 (const tak_histogram *h1, const tak_histogram *h2);
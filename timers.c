@@ -0,0 +1,128 @@
+/* Copyright (C) 2017 Thomas Allen Knotts IV - All Rights Reserved          */
+/* This file is part of the program ljmcmd                                  */
+/*                                                                          */
+/* ljmcmd is free software: you can redistribute it and/or modify           */
+/* it under the terms of the GNU General Public License as published by     */
+/* the Free Software Foundation, either version 3 of the License, or        */
+/* (at your option) any later version.                                      */
+/*                                                                          */
+/* ljmcmd is distributed in the hope that it will be useful,                */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of           */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            */
+/* GNU General Public License for more details.                             */
+/*                                                                          */
+/* You should have received a copy of the GNU General Public License        */
+/* along with ljmcmd.  If not, see <http://www.gnu.org/licenses/>.          */
+
+
+/* ======================================================================== */
+/* timers.c                                                                 */
+/*                                                                          */
+/* This file contains the subroutines that report the wall time spent in    */
+/* each part of the run.  The times are summed in the timers structure by   */
+/* the force pass, the MC drivers, rdf_accumulate(), write_trr(), and       */
+/* output_log_printf() with the monotonic clock of wall_clock().  The       */
+/* totals and the rates of the run are written at the end of the output     */
+/* file.  With the keyword "rates on" the MD steps or MC sweeps per second  */
+/* and the pair evaluations per second since the previous output line are   */
+/* added to each output line.  After a restart only the time of the         */
+/* current run is counted.                                                  */
+/* ======================================================================== */
+
+#include "includes.h"
+
+double wall_clock(void);
+
+/* ------------------------------------------------------------------- */
+/*  The clock and the counters at the previous output line             */
+/* ------------------------------------------------------------------- */
+static double mark_time, mark_pairs, mark_steps;
+
+/* ------------------------------------------------------------------- */
+/*  This function zeroes the timers and starts the clock of the run    */
+/* ------------------------------------------------------------------- */
+void timers_start(void)
+{
+  memset(&timers, 0, sizeof(timers));
+  timers.start = wall_clock();
+  mark_time = timers.start;
+  mark_pairs = 0.0;
+  mark_steps = 0.0;
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function returns the MD steps (or MC sweeps) done so far      */
+/* ------------------------------------------------------------------- */
+static double steps_done(void)
+{
+  if (!strcmp(sim.type, "md")) return(timers.mdsteps);
+  return(timers.mctrials / (double)sim.N);
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function returns the text added to an output line: the steps  */
+/*  (MD) or sweeps (MC) per second and the pair evaluations per second */
+/*  since the previous line.  It is empty unless "rates on" was given. */
+/* ------------------------------------------------------------------- */
+const char* timers_rates(void)
+{
+  static char text[64];
+  double now, dt, steps, pairs;
+
+  if (!sim.rates) return("");
+
+  now = wall_clock();
+  dt = now - mark_time;
+  steps = steps_done();
+  pairs = timers.pairs;
+  if (dt > 0.0) sprintf(text, "    %13.3lf    %13.6le", (steps - mark_steps) / dt, (pairs - mark_pairs) / dt);
+  else sprintf(text, "    %13.3lf    %13.6le", 0.0, 0.0);
+
+  mark_time = now;
+  mark_steps = steps;
+  mark_pairs = pairs;
+  return(text);
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function writes a line of the time table.  The percentage is  */
+/*  of the wall time of the run.                                       */
+/* ------------------------------------------------------------------- */
+static void write_time(FILE *fp, const char *label, double t, double total)
+{
+  fprintf(fp, "%-26s%10.3lf s  %6.2lf %%\n", label, t, (total > 0.0) ? 100.0 * t / total : 0.0);
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function writes the times and rates of the run to fp          */
+/* ------------------------------------------------------------------- */
+void timers_write(FILE *fp)
+{
+  double total = wall_clock() - timers.start;
+  double other, kernel;
+
+  other = total - timers.forces - timers.integrate - timers.trial - timers.rdf - timers.trajectory - timers.log;
+  kernel = timers.forces + timers.trial;
+
+  fprintf(fp, "\n***Timing***\n\n");
+  write_time(fp, "Wall Time:", total, total);
+  write_time(fp, "Force Evaluation:", timers.forces, total);
+  if (!strcmp(sim.type, "md")) write_time(fp, "Integration:", timers.integrate, total);
+  else write_time(fp, "MC Trial Moves:", timers.trial, total);
+  write_time(fp, "RDF Accumulation:", timers.rdf, total);
+  write_time(fp, "Trajectory Writing:", timers.trajectory, total);
+  write_time(fp, "Output Logging:", timers.log, total);
+  write_time(fp, "Other:", other, total);
+  fprintf(fp, "\n");
+  if (total > 0.0)
+  {
+    if (!strcmp(sim.type, "md"))
+    {
+      fprintf(fp, "MD Steps/s:                %10.3lf\n", timers.mdsteps / total);
+      fprintf(fp, "Reduced Time/Day:          %10.3lf\n", timers.mdsteps * sim.dt / total * 86400.0);
+    }
+    else fprintf(fp, "MC Sweeps/s:               %10.3lf\n", timers.mctrials / (double)sim.N / total);
+  }
+  if (kernel > 0.0) fprintf(fp, "Pair Evaluations/s:        %10.4le\n", timers.pairs / kernel);
+  fprintf(fp, "\n");
+}
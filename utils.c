@@ -54,3 +54,24 @@ int error_exit(int error_code)
   //getchar();
   exit(error_code);
 }
+
+/* ------------------------------------------------------------------- */
+/* wall_clock                                                          */
+/* This function returns the time in seconds from a monotonic clock    */
+/* with sub-microsecond resolution.  Only the difference between two   */
+/* calls is meaningful.  Without clock_gettime() the OpenMP clock, or  */
+/* clock() if there is no OpenMP, is used.                             */
+/* ------------------------------------------------------------------- */
+double wall_clock(void)
+{
+#if defined(__unix__) || defined(__APPLE__)
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return((double)ts.tv_sec + 1.0e-9*(double)ts.tv_nsec);
+#elif defined(_OPENMP)
+  return(omp_get_wtime());
+#else
+  return((double)clock() / (double)CLOCKS_PER_SEC);
+#endif
+}
@@ -23,6 +23,8 @@
 
 #include "includes.h"
 
+double wall_clock(void);
+
 /* ------------------------------------------------------------------- */
 /* This function is the first needed to use the velocity verlet        */
 /* algorithm.  It uses the data at time step t to update the positions */
@@ -33,47 +35,49 @@ int verlet1(void)
 {
   unsigned long i;
   double dx, dy, dz;
+  double t0 = wall_clock();
 	
   for(i=0; i<sim.N; i++)
 	{
     /* ------------------------------------------------------------------- */
     /*  Update the positions to a full time step                           */
     /* ------------------------------------------------------------------- */
-		dx = sim.dt*atom[i].vx + sim.dt*sim.dt*atom[i].fx / 2.0;
-    dy = sim.dt*atom[i].vy + sim.dt*sim.dt*atom[i].fy / 2.0;
-    dz = sim.dt*atom[i].vz + sim.dt*sim.dt*atom[i].fz / 2.0;
-    atom[i].x = atom[i].x+dx;
-		atom[i].y = atom[i].y+dy;
-		atom[i].z = atom[i].z+dz;
-    atom[i].dx += dx; //displacement accumulator for diffusivity 
-    atom[i].dy += dy; //displacement accumulator for diffusivity
-    atom[i].dz += dz; //displacement accumulator for diffusivity
+		dx = sim.dt*atom.vx[i] + sim.dt*sim.dt*atom.fx[i] / 2.0;
+    dy = sim.dt*atom.vy[i] + sim.dt*sim.dt*atom.fy[i] / 2.0;
+    dz = sim.dt*atom.vz[i] + sim.dt*sim.dt*atom.fz[i] / 2.0;
+    atom.x[i] = atom.x[i]+dx;
+		atom.y[i] = atom.y[i]+dy;
+		atom.z[i] = atom.z[i]+dz;
+    atom.dx[i] += dx; //displacement accumulator for diffusivity 
+    atom.dy[i] += dy; //displacement accumulator for diffusivity
+    atom.dz[i] += dz; //displacement accumulator for diffusivity
 
     /* ------------------------------------------------------------------- */
     /*  Apply Periodic Boundary Conditions                                 */
     /* ------------------------------------------------------------------- */
-		if(atom[i].x<0)
-			atom[i].x += sim.length;
-		else if(atom[i].x > sim.length)
-			atom[i].x -= sim.length;
+		if(atom.x[i]<0)
+			atom.x[i] += sim.length;
+		else if(atom.x[i] > sim.length)
+			atom.x[i] -= sim.length;
 
-		if(atom[i].y<0)
-			atom[i].y += sim.length;
-		else if(atom[i].y > sim.length)
-			atom[i].y -= sim.length;
+		if(atom.y[i]<0)
+			atom.y[i] += sim.length;
+		else if(atom.y[i] > sim.length)
+			atom.y[i] -= sim.length;
 		
-		if(atom[i].z<0)
-			atom[i].z += sim.length;
-		else if(atom[i].z > sim.length)
-			atom[i].z -= sim.length;
+		if(atom.z[i]<0)
+			atom.z[i] += sim.length;
+		else if(atom.z[i] > sim.length)
+			atom.z[i] -= sim.length;
 
     /* ------------------------------------------------------------------- */
     /*  Update the velocities to half a time step                          */
     /* ------------------------------------------------------------------- */
-		atom[i].vx = atom[i].vx+sim.dt*atom[i].fx/2.0;
-		atom[i].vy = atom[i].vy+sim.dt*atom[i].fy/2.0;
-		atom[i].vz = atom[i].vz+sim.dt*atom[i].fz/2.0;
+		atom.vx[i] = atom.vx[i]+sim.dt*atom.fx[i]/2.0;
+		atom.vy[i] = atom.vy[i]+sim.dt*atom.fy[i]/2.0;
+		atom.vz[i] = atom.vz[i]+sim.dt*atom.fz[i]/2.0;
 	}
+  timers.integrate += wall_clock() - t0;
   return(0);
 }
 
@@ -86,11 +90,14 @@ int verlet1(void)
 int verlet2(void)
 {
 	unsigned long i;
+  double t0 = wall_clock();
+
 	for(i=0; i<sim.N;i++)
 	{
-		atom[i].vx = atom[i].vx+sim.dt*atom[i].fx/2.0;
-		atom[i].vy = atom[i].vy+sim.dt*atom[i].fy/2.0;
-		atom[i].vz = atom[i].vz+sim.dt*atom[i].fz/2.0;
+		atom.vx[i] = atom.vx[i]+sim.dt*atom.fx[i]/2.0;
+		atom.vy[i] = atom.vy[i]+sim.dt*atom.fy[i]/2.0;
+		atom.vz[i] = atom.vz[i]+sim.dt*atom.fz[i]/2.0;
 	}
+  timers.integrate += wall_clock() - t0;
   return(0);
 }
@@ -21,26 +21,115 @@
 /* to a traj.trr file which can be read and	analyzed using Gromacs or VMD.  */
 /*    cycle = the current iteration number                                  */
 /*    flag = 0 for equilibration and 1 for production                       */
+/*                                                                          */
+/* Each frame is assembled big-endian in one reusable buffer and written    */
+/* with a single fwrite to the movie file, which stays open until           */
+/* write_trr_close() is called at the end of the run.  When the I/O thread  */
+/* of async_io.c is running, write_trr() only hands a copy of the arrays    */
+/* to it, and the thread calls write_trr_frame().  If the movie file has    */
+/* the .xtc extension the positions are written by write_xtc.c instead.     */
 /* ======================================================================== */
 
 #include "includes.h"
 
+#if defined(__GNUC__)
+#define BSWAP32(u) __builtin_bswap32(u)
+#define BSWAP64(u) __builtin_bswap64(u)
+#else
+#define BSWAP32(u) ((((u) & 0xFFu) << 24) | (((u) & 0xFF00u) << 8) | (((u) >> 8) & 0xFF00u) | ((u) >> 24))
+#define BSWAP64(u) (((uint64_t)BSWAP32((uint32_t)(u)) << 32) | BSWAP32((uint32_t)((u) >> 32)))
+#endif
+
 int reverse=1;									//set to 0 to turn off byte swapping
 int precision=8;								//set to 4 to use float precision
-FILE *das;
-int write_int(long);
-int write_float(float fp);
-int write_bstring(char *str);
-int write_vector(float *fp);
+FILE *das = NULL;
+static unsigned char *frame = NULL;
+static size_t frame_size = 0;
 int strip_white(char *str);
-void swap4(void *n);
-void swap8(void *n);
+void write_trr_close(void);
+bool async_io_frame(unsigned long, int);
+void write_xtc_frame(FILE*, unsigned long, int, const double*, const double*, const double*);
+void write_xtc_free(void);
+double wall_clock(void);
 
 int FLAG_x = 1;
 int FLAG_v = 0;
 int FLAG_f = 0;
 
-void write_trr(unsigned long cycle, int flag) {
+/* ------------------------------------------------------------------- */
+/*  This function stores a 4 byte integer at p and returns the next    */
+/*  position in the frame                                              */
+/* ------------------------------------------------------------------- */
+static unsigned char* put_int(unsigned char *p, long i)
+{
+  uint32_t u = (uint32_t)i;
+
+  if (reverse) u = BSWAP32(u);
+  memcpy(p, &u, 4);
+  return(p + 4);
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function stores a real with the precision of the file at p    */
+/*  and returns the next position in the frame                         */
+/* ------------------------------------------------------------------- */
+static unsigned char* put_real(unsigned char *p, float f)
+{
+  uint32_t u;
+  uint64_t w;
+  double d = (double)f;
+
+  if (precision == 4)
+  {
+    memcpy(&u, &f, 4);
+    if (reverse) u = BSWAP32(u);
+    memcpy(p, &u, 4);
+    return(p + 4);
+  }
+  memcpy(&w, &d, 8);
+  if (reverse) w = BSWAP64(w);
+  memcpy(p, &w, 8);
+  return(p + 8);
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function stores the n vectors (x, y, z)/10 of an atom array   */
+/*  in nm at p and returns the next position in the frame              */
+/* ------------------------------------------------------------------- */
+static unsigned char* put_vectors(unsigned char *p, const double *x, const double *y, const double *z, unsigned long n)
+{
+  unsigned long i;
+
+  for (i = 0; i < n; i++)
+  {
+    p = put_real(p, (float)(x[i]/10.0));
+    p = put_real(p, (float)(y[i]/10.0));
+    p = put_real(p, (float)(z[i]/10.0));
+  }
+  return(p);
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function opens the movie file for appending if it is not open */
+/* ------------------------------------------------------------------- */
+void write_trr_open(void)
+{
+  if (das != NULL) return;
+  das = fopen(sim.moviefile, "ab");
+  if (das == NULL)
+  {
+    fprintf(stdout, "failed to open movie file \"%s\"!\n", sim.moviefile);
+    exit(1);
+  }
+  atexit(write_trr_close);
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function writes one frame from the arrays v[0] to v[8], which */
+/*  are x, y, z, vx, vy, vz, fx, fy, and fz.  Only the arrays selected */
+/*  by FLAG_x, FLAG_v, and FLAG_f are read.                            */
+/* ------------------------------------------------------------------- */
+void write_trr_frame(unsigned long cycle, int flag, double *const *v) {
 long ir_size, e_size, vir_size, pres_size, top_size, sym_size, nre;
 long box_size, x_size, v_size, f_size;
 float lambda;
@@ -49,12 +138,15 @@ long VERSION;
 long time_ind; float time_val;
 float bx[9];
 unsigned long i;
-float pos[3];
-float vel[3];
 char title[2]={""};
-float force[3];
+size_t size;
+unsigned char *p;
 
-das=fopen(sim.moviefile,"ab");
+write_trr_open();
+if (!strcmp(sim.movieformat, "xtc")) {
+	write_xtc_frame(das, cycle, flag, v[0], v[1], v[2]);
+	return;
+}
 
 //setting some variables gromacs will look for.  no clue what they do.
 ir_size=0; e_size=0; vir_size=0; pres_size=0; top_size=0; sym_size=0; nre=0;
@@ -83,27 +175,42 @@ else {
 	time_ind = sim.eq+cycle;
 }
 
-write_int(MAGIC);
-write_int(VERSION);
-
-write_bstring(title);
-
-write_int(ir_size);
-write_int(e_size);
-write_int(box_size);
-write_int(vir_size);
-write_int(pres_size);
-write_int(top_size);
-write_int(sym_size);
-write_int(x_size);
-write_int(v_size);
-write_int(f_size);
-write_int(sim.N);
-write_int(time_ind);
-write_int(nre);
-
-write_float(time_val);
-write_float(lambda);
+//make sure the frame buffer can hold the header, box, and vectors
+size = 16*4 + strlen(title) + 2*precision + box_size + x_size + v_size + f_size;
+if (size > frame_size) {
+	free(frame);
+	frame = (unsigned char*) malloc(size);
+	if (frame == NULL) {
+		fprintf(stdout, "ERROR: cannot allocate memory for the trr frame\n");
+		exit(11);
+	}
+	frame_size = size;
+}
+p = frame;
+
+p = put_int(p, MAGIC);
+p = put_int(p, VERSION);
+
+p = put_int(p, (long)strlen(title));
+memcpy(p, title, strlen(title));
+p += strlen(title);
+
+p = put_int(p, ir_size);
+p = put_int(p, e_size);
+p = put_int(p, box_size);
+p = put_int(p, vir_size);
+p = put_int(p, pres_size);
+p = put_int(p, top_size);
+p = put_int(p, sym_size);
+p = put_int(p, x_size);
+p = put_int(p, v_size);
+p = put_int(p, f_size);
+p = put_int(p, sim.N);
+p = put_int(p, time_ind);
+p = put_int(p, nre);
+
+p = put_real(p, time_val);
+p = put_real(p, lambda);
 
 //writes the array for  box dimensions
 
@@ -114,153 +221,59 @@ bx[0]=(float)(sim.length/10.0);
 bx[4]=(float)(sim.length/10.0);
 bx[8]=(float)(sim.length/10.0);
 
-write_vector(&bx[0]);
-write_vector(&bx[3]);
-write_vector(&bx[6]);
+for (i=0; i<9; i++)
+	p = put_real(p, bx[i]);
 
-//writes the array for positions
+//writes the arrays for positions, velocities, and forces
 //converts units to nm
+if (FLAG_x !=0) p = put_vectors(p, v[0], v[1], v[2], sim.N);
+if (FLAG_v !=0) p = put_vectors(p, v[3], v[4], v[5], sim.N);
+if (FLAG_f !=0) p = put_vectors(p, v[6], v[7], v[8], sim.N);
 
-//printf("atom posits\n");
-if (FLAG_x !=0) {
-	for (i=0; i<sim.N; i++) {
-		pos[0]=(float)(atom[i].x/10.0);				// figure out with or w/o pbc
-		pos[1]=(float)(atom[i].y/10.0);
-		pos[2]=(float)(atom[i].z/10.0);
-		write_vector(pos);
-	}
-}
-
-//writes velocities
-
-//printf("atom velocities\n");
-if (FLAG_v !=0) {
-	for (i=0; i<sim.N; i++) {
-		vel[0]=(float)(atom[i].vx/10.0);
-		vel[1]=(float)(atom[i].vy/10.0);
-		vel[2]=(float)(atom[i].vz/10.0);
-		write_vector(vel);
-	}
-}
-
-//writes forces
-
-//printf("atom forces\n");
-if (FLAG_f !=0) {
-	for (i=0; i<sim.N; i++) {
-		force[0]=(float)(atom[i].fx/10.0);
-		force[1]=(float)(atom[i].fy/10.0);
-		force[2]=(float)(atom[i].fz/10.0);
-		write_vector(force);
-	//	printf("%lf %lf %lf\n",force[0],force[1],force[2]);
-	}
-}
-
-fclose(das);
-}
-
-
-
-int write_int(long i) {
-	long si;
-
-	if(!reverse) {
-		if (fwrite(&i,4,1,das)!=1) 
-			return 0;
-		else
-			return 1;
-	}
-	else {
-		si = i;
-		swap4((void *) &si);
-		if (fwrite(&si,4,1,das)!=1)
-			return 0;
-		else
-			return 1;
-	}
-}
-
-
-int write_float(float fp) {
-	if (precision==4) {
-		float sfp;
-		sfp=fp;
-		if (reverse)
-			swap4((void *) &sfp);
-		if(fwrite(&sfp,precision,1,das)!=1)
-			return 0;
-		else 
-			return 1;
-	}
-
-	else {
-		double sfp;
-		sfp = (double) fp;
-		if (reverse)
-			swap8((void *) &sfp);
-
-		if(fwrite(&sfp,precision,1,das)!=1)
-			return 0;
-		else
-			return 1;
-	}
+if (fwrite(frame, 1, (size_t)(p - frame), das) != (size_t)(p - frame)) {
+	printf("failed to write trr frame!\n");
+	exit(1);
 }
-
-
-int write_vector(float *fp) {
-	if ( (!write_float(fp[0])) || (!write_float(fp[1])) ||
-		(!write_float(fp[2])) ) {
-		printf("failed to write vector!\n");
-		exit(1);
-	}
-	else 
-		return 1;
 }
 
-
-int write_bstring(char *str) {
-//	printf("length: %d\nstring:\n%s\n",strlen(str),str);
-
-	if(!write_int(strlen(str))) {
-		fprintf(stdout,"failed to write string length!\n");
-		exit(1);
-	}
-	
-	if (fwrite(str,1,strlen(str),das)!=1) 
-		return 0;
-	else 
-		return -1;
+/* ------------------------------------------------------------------- */
+/*  This function writes a frame of the current configuration.  The    */
+/*  frame is queued for the I/O thread if it is running.               */
+/* ------------------------------------------------------------------- */
+void write_trr(unsigned long cycle, int flag)
+{
+  double *v[9];
+  double t0 = wall_clock();
+
+  if (!async_io_frame(cycle, flag))
+  {
+    v[0] = atom.x;  v[1] = atom.y;  v[2] = atom.z;
+    v[3] = atom.vx; v[4] = atom.vy; v[5] = atom.vz;
+    v[6] = atom.fx; v[7] = atom.fy; v[8] = atom.fz;
+    write_trr_frame(cycle, flag, v);
+  }
+  timers.trajectory += wall_clock() - t0;
 }
 
-
-void swap4(void *n) {
-	char temp[2];
-	char *c = (char *) n;
-	temp[0] = c[3];
-	temp[1] = c[2];
-	c[3] = c[0];
-	c[2] = c[1];
-	c[1] = temp[1];
-	c[0] = temp[0];
-	return;
+/* ------------------------------------------------------------------- */
+/*  This function writes the frames buffered by stdio to the file      */
+/* ------------------------------------------------------------------- */
+void write_trr_flush(void)
+{
+  if (das != NULL) fflush(das);
 }
 
-void swap8(void *n) {
-	char temp[4];
-	char *c = (char *) n;
-	temp[0]=c[7];
-	temp[1]=c[6];
-	temp[2]=c[5];
-	temp[3]=c[4];
-	c[7]=c[0];
-	c[6]=c[1];
-	c[5]=c[2];
-	c[4]=c[3];
-	c[3]=temp[3];
-	c[2]=temp[2];
-	c[1]=temp[1];
-	c[0]=temp[0];
-	return;
+/* ------------------------------------------------------------------- */
+/*  This function closes the movie file and frees the frame buffer     */
+/* ------------------------------------------------------------------- */
+void write_trr_close(void)
+{
+  if (das != NULL) fclose(das);
+  free(frame);
+  write_xtc_free();
+  das = NULL;
+  frame = NULL;
+  frame_size = 0;
 }
 
 
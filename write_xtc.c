@@ -0,0 +1,460 @@
+/* Copyright (C) 2017 Thomas Allen Knotts IV - All Rights Reserved          */
+/* This file is part of the program ljmcmd                                  */
+/*                                                                          */
+/* ljmcmd is free software: you can redistribute it and/or modify           */
+/* it under the terms of the GNU General Public License as published by     */
+/* the Free Software Foundation, either version 3 of the License, or        */
+/* (at your option) any later version.                                      */
+/*                                                                          */
+/* ljmcmd is distributed in the hope that it will be useful,                */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of           */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            */
+/* GNU General Public License for more details.                             */
+/*                                                                          */
+/* You should have received a copy of the GNU General Public License        */
+/* along with ljmcmd.  If not, see <http://www.gnu.org/licenses/>.          */
+
+/* ======================================================================== */
+/* write_xtc.c                                                              */
+/*                                                                          */
+/* This file writes the positions to a compressed .xtc file that can be     */
+/* read by Gromacs or VMD.  The positions are rounded to 1/XTC_PRECISION nm */
+/* and packed with the xdr3dfcoord algorithm of the Gromacs xdrfile         */
+/* library: each atom is stored relative to the minimum of the frame with   */
+/* the fewest bits that hold the range, and runs of close atoms are stored  */
+/* as small differences whose size adapts along the frame.  A frame takes   */
+/* roughly 4 to 6 bytes per atom instead of 24 in a double .trr frame.      */
+/* ======================================================================== */
+
+#include "includes.h"
+#include <limits.h>
+
+/* =======================Constants============================== */
+#define XTC_MAGIC 1995
+#define XTC_PRECISION 1000.0f
+#define XTC_FIRSTIDX 9
+#define XTC_MAXABS (INT_MAX - 2)
+/* ============================================================= */
+
+static const int magicints[] = {
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 8, 10, 12, 16, 20, 25, 32, 40, 50, 64,
+  80, 101, 128, 161, 203, 256, 322, 406, 512, 645, 812, 1024, 1290,
+  1625, 2048, 2580, 3250, 4096, 5060, 6501, 8192, 10321, 13003,
+  16384, 20642, 26007, 32768, 41285, 52015, 65536, 82570, 104031,
+  131072, 165140, 208063, 262144, 330280, 416127, 524287, 660561,
+  832255, 1048576, 1321122, 1664510, 2097152, 2642245, 3329021,
+  4194304, 5284491, 6658042, 8388607, 10568983, 13316085, 16777216 };
+#define XTC_LASTIDX ((int)(sizeof(magicints) / sizeof(*magicints)))
+
+/* ------------------------------------------------------------------- */
+/*  This structure holds the state of the bit packer                   */
+/* ------------------------------------------------------------------- */
+struct bit_buffer {
+  unsigned char   *data;                /* packed bytes                */
+  int             cnt;                  /* complete bytes in data      */
+  unsigned int    lastbits;             /* bits waiting in lastbyte    */
+  unsigned int    lastbyte;             /* bits not yet stored         */
+};
+
+static unsigned char *xtc_frame = NULL;
+static size_t xtc_size = 0;
+static int *xtc_int = NULL;
+
+/* ------------------------------------------------------------------- */
+/*  This function stores a 4 byte big-endian (XDR) integer at p        */
+/* ------------------------------------------------------------------- */
+static unsigned char* put_xdr_int(unsigned char *p, int i)
+{
+  uint32_t u = (uint32_t)i;
+
+  p[0] = (unsigned char)(u >> 24);
+  p[1] = (unsigned char)(u >> 16);
+  p[2] = (unsigned char)(u >> 8);
+  p[3] = (unsigned char)u;
+  return(p + 4);
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function stores a 4 byte big-endian (XDR) float at p          */
+/* ------------------------------------------------------------------- */
+static unsigned char* put_xdr_float(unsigned char *p, float f)
+{
+  int32_t i;
+
+  memcpy(&i, &f, 4);
+  return(put_xdr_int(p, i));
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function returns the number of bits needed to store an        */
+/*  integer in [0, size)                                               */
+/* ------------------------------------------------------------------- */
+static int sizeofint(int size)
+{
+  unsigned int num = 1;
+  int num_of_bits = 0;
+
+  while (size >= (int)num && num_of_bits < 32)
+  {
+    num_of_bits++;
+    num <<= 1;
+  }
+  return(num_of_bits);
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function returns the number of bits needed to store three     */
+/*  integers in [0, sizes[k]) as one mixed-radix number                */
+/* ------------------------------------------------------------------- */
+static int sizeofints(const int *sizes)
+{
+  int i, num_of_bytes = 1, bytecnt, num_of_bits = 0;
+  unsigned int bytes[32], num, tmp;
+
+  bytes[0] = 1;
+  for (i = 0; i < 3; i++)
+  {
+    tmp = 0;
+    for (bytecnt = 0; bytecnt < num_of_bytes; bytecnt++)
+    {
+      tmp = bytes[bytecnt]*sizes[i] + tmp;
+      bytes[bytecnt] = tmp & 0xff;
+      tmp >>= 8;
+    }
+    while (tmp != 0)
+    {
+      bytes[bytecnt++] = tmp & 0xff;
+      tmp >>= 8;
+    }
+    num_of_bytes = bytecnt;
+  }
+  num = 1;
+  num_of_bytes--;
+  while (bytes[num_of_bytes] >= num)
+  {
+    num_of_bits++;
+    num *= 2;
+  }
+  return(num_of_bits + num_of_bytes*8);
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function appends the low num_of_bits bits of num to b         */
+/* ------------------------------------------------------------------- */
+static void sendbits(struct bit_buffer *b, int num_of_bits, int num)
+{
+  while (num_of_bits >= 8)
+  {
+    b->lastbyte = (b->lastbyte << 8) | ((num >> (num_of_bits - 8)) & 0xff);
+    b->data[b->cnt++] = (unsigned char)(b->lastbyte >> b->lastbits);
+    num_of_bits -= 8;
+  }
+  if (num_of_bits > 0)
+  {
+    b->lastbyte = (b->lastbyte << num_of_bits) | num;
+    b->lastbits += num_of_bits;
+    if (b->lastbits >= 8)
+    {
+      b->lastbits -= 8;
+      b->data[b->cnt++] = (unsigned char)(b->lastbyte >> b->lastbits);
+    }
+  }
+  if (b->lastbits > 0) b->data[b->cnt] = (unsigned char)(b->lastbyte << (8 - b->lastbits));
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function appends three integers in [0, sizes[k]) to b as one  */
+/*  mixed-radix number of num_of_bits bits                             */
+/* ------------------------------------------------------------------- */
+static void sendints(struct bit_buffer *b, int num_of_bits, const int *sizes, const int *nums)
+{
+  int i, num_of_bytes = 0, bytecnt;
+  unsigned int bytes[32], tmp;
+
+  tmp = nums[0];
+  do
+  {
+    bytes[num_of_bytes++] = tmp & 0xff;
+    tmp >>= 8;
+  } while (tmp != 0);
+
+  for (i = 1; i < 3; i++)
+  {
+    tmp = nums[i];
+    for (bytecnt = 0; bytecnt < num_of_bytes; bytecnt++)
+    {
+      tmp = bytes[bytecnt]*sizes[i] + tmp;
+      bytes[bytecnt] = tmp & 0xff;
+      tmp >>= 8;
+    }
+    while (tmp != 0)
+    {
+      bytes[bytecnt++] = tmp & 0xff;
+      tmp >>= 8;
+    }
+    num_of_bytes = bytecnt;
+  }
+  if (num_of_bits >= num_of_bytes*8)
+  {
+    for (i = 0; i < num_of_bytes; i++) sendbits(b, 8, bytes[i]);
+    sendbits(b, num_of_bits - num_of_bytes*8, 0);
+  }
+  else
+  {
+    for (i = 0; i < num_of_bytes - 1; i++) sendbits(b, 8, bytes[i]);
+    sendbits(b, num_of_bits - (num_of_bytes - 1)*8, bytes[i]);
+  }
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function packs the n integer positions in ip (3n values) into */
+/*  b and stores minint, maxint, and smallidx at p.  It returns the    */
+/*  next position after these header values.  ip is reordered.         */
+/* ------------------------------------------------------------------- */
+static unsigned char* pack_coords(unsigned char *p, struct bit_buffer *b, int *ip, int n)
+{
+  int minint[3] = {INT_MAX, INT_MAX, INT_MAX};
+  int maxint[3] = {INT_MIN, INT_MIN, INT_MIN};
+  int sizeint[3], bitsizeint[3], sizesmall[3], tmpcoord[30], prevcoord[3] = {0, 0, 0};
+  int i, k, diff, mindiff = INT_MAX, bitsize;
+  int smallidx, maxidx, minidx, smaller, smallnum, larger;
+  int is_small, is_smaller, run, prevrun = -1, tmp;
+  int *thiscoord;
+
+  for (i = 0; i < n; i++)
+  {
+    for (k = 0; k < 3; k++)
+    {
+      if (ip[3*i + k] < minint[k]) minint[k] = ip[3*i + k];
+      if (ip[3*i + k] > maxint[k]) maxint[k] = ip[3*i + k];
+    }
+    if (i > 0)
+    {
+      diff = abs(ip[3*i] - ip[3*i - 3]) + abs(ip[3*i + 1] - ip[3*i - 2]) + abs(ip[3*i + 2] - ip[3*i - 1]);
+      if (diff < mindiff) mindiff = diff;
+    }
+  }
+  for (k = 0; k < 3; k++) p = put_xdr_int(p, minint[k]);
+  for (k = 0; k < 3; k++) p = put_xdr_int(p, maxint[k]);
+
+  for (k = 0; k < 3; k++) sizeint[k] = maxint[k] - minint[k] + 1;
+  if ((sizeint[0] | sizeint[1] | sizeint[2]) > 0xffffff)
+  {
+    for (k = 0; k < 3; k++) bitsizeint[k] = sizeofint(sizeint[k]);
+    bitsize = 0; //flag the use of large sizes
+  }
+  else
+  {
+    for (k = 0; k < 3; k++) bitsizeint[k] = 0;
+    bitsize = sizeofints(sizeint);
+  }
+
+  smallidx = XTC_FIRSTIDX;
+  while (smallidx < XTC_LASTIDX && magicints[smallidx] < mindiff) smallidx++;
+  p = put_xdr_int(p, smallidx);
+
+  maxidx = (XTC_LASTIDX < smallidx + 8) ? XTC_LASTIDX : smallidx + 8;
+  minidx = maxidx - 8;
+  smaller = magicints[(XTC_FIRSTIDX > smallidx - 1) ? XTC_FIRSTIDX : smallidx - 1] / 2;
+  smallnum = magicints[smallidx] / 2;
+  sizesmall[0] = sizesmall[1] = sizesmall[2] = magicints[smallidx];
+  larger = magicints[maxidx] / 2;
+
+  i = 0;
+  while (i < n)
+  {
+    is_small = 0;
+    thiscoord = ip + 3*i;
+    if (smallidx < maxidx && i >= 1 &&
+        abs(thiscoord[0] - prevcoord[0]) < larger &&
+        abs(thiscoord[1] - prevcoord[1]) < larger &&
+        abs(thiscoord[2] - prevcoord[2]) < larger) is_smaller = 1;
+    else if (smallidx > minidx) is_smaller = -1;
+    else is_smaller = 0;
+
+    /* ============================================ */
+    /*  If the next atom is close, swap the two so  */
+    /*  that the run starts with a small step       */
+    /* ============================================ */
+    if (i + 1 < n &&
+        abs(thiscoord[0] - thiscoord[3]) < smallnum &&
+        abs(thiscoord[1] - thiscoord[4]) < smallnum &&
+        abs(thiscoord[2] - thiscoord[5]) < smallnum)
+    {
+      for (k = 0; k < 3; k++)
+      {
+        tmp = thiscoord[k];
+        thiscoord[k] = thiscoord[k + 3];
+        thiscoord[k + 3] = tmp;
+      }
+      is_small = 1;
+    }
+
+    /* ============================================ */
+    /*  Store the atom relative to the minimum      */
+    /* ============================================ */
+    for (k = 0; k < 3; k++) tmpcoord[k] = thiscoord[k] - minint[k];
+    if (bitsize == 0) for (k = 0; k < 3; k++) sendbits(b, bitsizeint[k], tmpcoord[k]);
+    else sendints(b, bitsize, sizeint, tmpcoord);
+    for (k = 0; k < 3; k++) prevcoord[k] = thiscoord[k];
+    thiscoord += 3;
+    i++;
+
+    /* ============================================ */
+    /*  Collect a run of up to 8 close atoms        */
+    /* ============================================ */
+    run = 0;
+    if (is_small == 0 && is_smaller == -1) is_smaller = 0;
+    while (is_small && run < 8*3)
+    {
+      if (is_smaller == -1 &&
+          (double)(thiscoord[0] - prevcoord[0])*(thiscoord[0] - prevcoord[0]) +
+          (double)(thiscoord[1] - prevcoord[1])*(thiscoord[1] - prevcoord[1]) +
+          (double)(thiscoord[2] - prevcoord[2])*(thiscoord[2] - prevcoord[2]) >= (double)smaller*smaller) is_smaller = 0;
+
+      for (k = 0; k < 3; k++)
+      {
+        tmpcoord[run++] = thiscoord[k] - prevcoord[k] + smallnum;
+        prevcoord[k] = thiscoord[k];
+      }
+      i++;
+      thiscoord += 3;
+      is_small = 0;
+      if (i < n &&
+          abs(thiscoord[0] - prevcoord[0]) < smallnum &&
+          abs(thiscoord[1] - prevcoord[1]) < smallnum &&
+          abs(thiscoord[2] - prevcoord[2]) < smallnum) is_small = 1;
+    }
+    if (run != prevrun || is_smaller != 0)
+    {
+      prevrun = run;
+      sendbits(b, 1, 1); //flag the change in run length
+      sendbits(b, 5, run + is_smaller + 1);
+    }
+    else sendbits(b, 1, 0);
+    for (k = 0; k < run; k += 3) sendints(b, smallidx, sizesmall, &tmpcoord[k]);
+
+    /* ============================================ */
+    /*  Adapt the size of the small differences     */
+    /* ============================================ */
+    if (is_smaller != 0)
+    {
+      smallidx += is_smaller;
+      if (is_smaller < 0)
+      {
+        smallnum = smaller;
+        smaller = (smallidx > XTC_FIRSTIDX) ? magicints[smallidx - 1] / 2 : 0;
+      }
+      else
+      {
+        smaller = smallnum;
+        smallnum = magicints[smallidx] / 2;
+      }
+      sizesmall[0] = sizesmall[1] = sizesmall[2] = magicints[smallidx];
+    }
+  }
+  return(p);
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function writes one frame of the positions x, y, and z to fp  */
+/*    cycle = the current iteration number                             */
+/*    flag = 0 for equilibration and 1 for production                  */
+/* ------------------------------------------------------------------- */
+void write_xtc_frame(FILE *fp, unsigned long cycle, int flag, const double *x, const double *y, const double *z)
+{
+  int n = (int)sim.N;
+  int i, k, step;
+  float box, time_val, f;
+  size_t size = 92 + 16*(size_t)sim.N + 64;
+  unsigned char *p;
+  struct bit_buffer b;
+  double lf;
+  const double *r[3];
+
+  /* ------------------------------------------------------------------- */
+  /*  Make sure the buffers can hold the frame                           */
+  /* ------------------------------------------------------------------- */
+  if (size > xtc_size)
+  {
+    free(xtc_frame);
+    free(xtc_int);
+    xtc_frame = (unsigned char*) calloc(size, 1);
+    xtc_int = (int*) malloc(3*sim.N*sizeof(int));
+    if (xtc_frame == NULL || xtc_int == NULL)
+    {
+      fprintf(stdout, "ERROR: cannot allocate memory for the xtc frame\n");
+      exit(11);
+    }
+    xtc_size = size;
+  }
+
+  if (flag == 0) step = (int)cycle;
+  else step = (int)(sim.eq + cycle);
+  time_val = (float)(sim.dt*1.0*step);
+  box = (float)(sim.length/10.0);
+
+  /* ------------------------------------------------------------------- */
+  /*  Header and box                                                     */
+  /* ------------------------------------------------------------------- */
+  p = xtc_frame;
+  p = put_xdr_int(p, XTC_MAGIC);
+  p = put_xdr_int(p, n);
+  p = put_xdr_int(p, step);
+  p = put_xdr_float(p, time_val);
+  for (i = 0; i < 9; i++) p = put_xdr_float(p, (i % 4 == 0) ? box : 0.0f);
+  p = put_xdr_int(p, n);
+
+  /* ------------------------------------------------------------------- */
+  /*  Small systems are written uncompressed.  Otherwise round the       */
+  /*  positions in nm to integers and pack them.                         */
+  /* ------------------------------------------------------------------- */
+  r[0] = x;
+  r[1] = y;
+  r[2] = z;
+  if (n <= 9)
+  {
+    for (i = 0; i < n; i++)
+      for (k = 0; k < 3; k++) p = put_xdr_float(p, (float)(r[k][i]/10.0));
+  }
+  else
+  {
+    p = put_xdr_float(p, XTC_PRECISION);
+    for (i = 0; i < n; i++)
+    {
+      for (k = 0; k < 3; k++)
+      {
+        f = (float)(r[k][i]/10.0);
+        lf = (f >= 0.0f) ? f*XTC_PRECISION + 0.5 : f*XTC_PRECISION - 0.5;
+        if (fabs(lf) > XTC_MAXABS)
+        {
+          fprintf(stdout, "The positions are too large to be written to the xtc file.\n");
+          exit(1);
+        }
+        xtc_int[3*i + k] = (int)lf;
+      }
+    }
+    b.data = p + 8*4; //after minint, maxint, smallidx, and the length
+    b.cnt = 0;
+    b.lastbits = 0;
+    b.lastbyte = 0;
+    p = pack_coords(p, &b, xtc_int, n);
+    if (b.lastbits != 0) b.cnt++;
+    p = put_xdr_int(p, b.cnt);
+    p += b.cnt;
+    while ((p - xtc_frame) % 4) *p++ = 0; //XDR pads opaque data to 4 bytes
+  }
+  fwrite(xtc_frame, 1, (size_t)(p - xtc_frame), fp);
+}
+
+/* ------------------------------------------------------------------- */
+/*  This function frees the frame buffers                              */
+/* ------------------------------------------------------------------- */
+void write_xtc_free(void)
+{
+  free(xtc_frame);
+  free(xtc_int);
+  xtc_frame = NULL;
+  xtc_int = NULL;
+  xtc_size = 0;
+}